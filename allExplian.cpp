@@ -1,4 +1,52 @@
 #include"All.h"
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <queue>
+#include <thread>
+#include <filesystem>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(HEADLESS_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(HEADLESS_OSMESA)
+#include <GL/osmesa.h>
+#endif
+#if defined(__has_include)
+#if __has_include("stb_image_write.h")
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#define HEADLESS_PNG
+#endif
+#endif
 
 // ====================== Input 输入管理类 ======================
 #pragma region Input
@@ -59,6 +107,1072 @@ void Input::InitInput() {
 #pragma endregion
 
 
+// ====================== Memory 内存池与帧分配器 ======================
+#pragma region Memory
+
+// 分配统计的子系统
+enum class AllocTag { GameObjects, Components, Scripts, Frame, Count };
+
+// 按子系统统计分配次数和字节数（供性能面板和基准测试读取）
+class AllocStats {
+public:
+    struct Counters {
+        std::atomic<long long> allocations{ 0 }, frees{ 0 }, liveBytes{ 0 }, peakBytes{ 0 };
+    };
+    static Counters counters[(int)AllocTag::Count];
+    static const char* names[(int)AllocTag::Count];
+    static void Allocated(AllocTag tag, size_t bytes);
+    static void Freed(AllocTag tag, size_t bytes);
+    static void Report(std::ostream& out);
+    static void OnGUI();
+};
+
+// 定长块内存池（按块链表管理空闲块，整块向系统申请，不归还给系统）
+class PoolAllocator {
+public:
+    PoolAllocator(size_t blockSize, size_t blocksPerChunk, AllocTag tag);
+    void* Allocate();
+    void Free(void* p);
+    // 按大小分级的内存池（每16字节一级，超过上限的直接走系统分配）
+    static void* Allocate(size_t size, AllocTag tag);
+    static void Free(void* p, size_t size, AllocTag tag);
+    static const size_t maxPooledSize = 1024;
+    size_t blockSize, live = 0, capacity = 0;
+private:
+    static PoolAllocator& ForSize(size_t size, AllocTag tag);
+    struct FreeNode { FreeNode* next; };
+    FreeNode* freeList = nullptr;
+    size_t blocksPerChunk;
+    AllocTag tag;
+    std::vector<void*> chunks;
+    std::mutex mutex;
+};
+
+// 给标准容器用的内存池分配器（单个元素的分配走内存池，如std::list的节点）
+template<typename T, AllocTag Tag>
+struct PoolStlAllocator {
+    typedef T value_type;
+    PoolStlAllocator() {}
+    template<typename U> PoolStlAllocator(const PoolStlAllocator<U, Tag>&) {}
+    template<typename U> struct rebind { typedef PoolStlAllocator<U, Tag> other; };
+    T* allocate(size_t n) { return (T*)PoolAllocator::Allocate(n * sizeof(T), Tag); }
+    void deallocate(T* p, size_t n) { PoolAllocator::Free(p, n * sizeof(T), Tag); }
+    template<typename U> bool operator==(const PoolStlAllocator<U, Tag>&) const { return true; }
+    template<typename U> bool operator!=(const PoolStlAllocator<U, Tag>&) const { return false; }
+};
+
+// 每帧线性分配器（只移动指针，帧结束时整体重置；只在主线程使用）
+class FrameArena {
+public:
+    static void* Allocate(size_t bytes, size_t alignment = 16);
+    template<typename T> static T* Allocate(size_t count) { return (T*)Allocate(sizeof(T) * count, alignof(T) > 16 ? alignof(T) : 16); }
+    static void Reset();      // 帧结束时调用（超出容量时把块合并为一个更大的块）
+    static size_t used, capacity, peak;
+private:
+    static std::vector<unsigned char*> blocks;
+    static std::vector<size_t> sizes;
+    static size_t offset;
+};
+
+// 静态成员初始化
+AllocStats::Counters AllocStats::counters[(int)AllocTag::Count];
+const char* AllocStats::names[(int)AllocTag::Count] = { "GameObjects", "Components", "Scripts", "Frame" };
+size_t FrameArena::used = 0;
+size_t FrameArena::capacity = 0;
+size_t FrameArena::peak = 0;
+std::vector<unsigned char*> FrameArena::blocks;
+std::vector<size_t> FrameArena::sizes;
+size_t FrameArena::offset = 0;
+
+void AllocStats::Allocated(AllocTag tag, size_t bytes) {
+    Counters& c = counters[(int)tag];
+    c.allocations++;
+    long long live = c.liveBytes += (long long)bytes;
+    long long peak = c.peakBytes.load();
+    while (live > peak && !c.peakBytes.compare_exchange_weak(peak, live)) {}
+}
+
+void AllocStats::Freed(AllocTag tag, size_t bytes) {
+    Counters& c = counters[(int)tag];
+    c.frees++;
+    c.liveBytes -= (long long)bytes;
+}
+
+// 输出统计（基准测试用）
+void AllocStats::Report(std::ostream & out) {
+    for (int i = 0; i < (int)AllocTag::Count; i++)
+        out << names[i] << " allocations " << counters[i].allocations << " frees " << counters[i].frees
+            << " live " << counters[i].liveBytes << " peak " << counters[i].peakBytes << std::endl;
+}
+
+// ImGui 调试界面（显示各子系统的分配统计）
+void AllocStats::OnGUI() {
+    if (ImGui::TreeNode("Allocations")) {
+        for (int i = 0; i < (int)AllocTag::Count; i++)
+            ImGui::Text("%-12s allocs %lld  frees %lld  live %.1f KB  peak %.1f KB", names[i],
+                counters[i].allocations.load(), counters[i].frees.load(),
+                counters[i].liveBytes.load() / 1024.0f, counters[i].peakBytes.load() / 1024.0f);
+        ImGui::Text("frame arena: %.1f / %.1f KB (peak %.1f KB)", FrameArena::used / 1024.0f,
+            FrameArena::capacity / 1024.0f, FrameArena::peak / 1024.0f);
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+// 构造函数（块大小至少能放下空闲链表指针，并按16字节对齐）
+PoolAllocator::PoolAllocator(size_t blockSize, size_t blocksPerChunk, AllocTag tag)
+    : blockSize((std::max(blockSize, sizeof(FreeNode)) + 15) & ~(size_t)15), blocksPerChunk(blocksPerChunk), tag(tag) {}
+
+void* PoolAllocator::Allocate() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!freeList) { // 空闲链表用完，申请新的一整块并切分
+        unsigned char* chunk = (unsigned char*)_mm_malloc(blockSize * blocksPerChunk, 16);
+        chunks.push_back(chunk);
+        for (size_t i = blocksPerChunk; i-- > 0;) {
+            FreeNode* node = (FreeNode*)(chunk + i * blockSize);
+            node->next = freeList;
+            freeList = node;
+        }
+        capacity += blocksPerChunk;
+    }
+    FreeNode* node = freeList;
+    freeList = node->next;
+    live++;
+    AllocStats::Allocated(tag, blockSize);
+    return node;
+}
+
+void PoolAllocator::Free(void * p) {
+    if (!p) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    FreeNode* node = (FreeNode*)p;
+    node->next = freeList;
+    freeList = node;
+    live--;
+    AllocStats::Freed(tag, blockSize);
+}
+
+// 查找对应大小级别的内存池（首次使用时创建，之后不再销毁）
+PoolAllocator & PoolAllocator::ForSize(size_t size, AllocTag tag) {
+    // 双重检查：发布用release、读取用acquire，其他线程看到指针时池已构造完成
+    static std::atomic<PoolAllocator*> pools[(int)AllocTag::Count][maxPooledSize / 16] = {};
+    static std::mutex mutex;
+    size_t index = (size + 15) / 16 - 1;
+    std::atomic<PoolAllocator*>& slot = pools[(int)tag][index];
+    PoolAllocator* pool = slot.load(std::memory_order_acquire);
+    if (!pool) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pool = slot.load(std::memory_order_relaxed);
+        if (!pool) {
+            pool = new PoolAllocator((index + 1) * 16, 256, tag);
+            slot.store(pool, std::memory_order_release);
+        }
+    }
+    return *pool;
+}
+
+void* PoolAllocator::Allocate(size_t size, AllocTag tag) {
+    if (size == 0 || size > maxPooledSize) {
+        AllocStats::Allocated(tag, size);
+        return _mm_malloc(size ? size : 1, 16);
+    }
+    return ForSize(size, tag).Allocate();
+}
+
+void PoolAllocator::Free(void * p, size_t size, AllocTag tag) {
+    if (!p) return;
+    if (size == 0 || size > maxPooledSize) {
+        AllocStats::Freed(tag, size);
+        _mm_free(p);
+        return;
+    }
+    ForSize(size, tag).Free(p);
+}
+
+// 线性分配（当前块不够时追加新块，本帧内已分配的指针保持有效）
+void* FrameArena::Allocate(size_t bytes, size_t alignment) {
+    if (blocks.empty()) {
+        blocks.push_back((unsigned char*)_mm_malloc(1 << 20, 64));
+        sizes.push_back(1 << 20);
+        capacity = 1 << 20;
+    }
+    size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+    if (aligned + bytes > sizes.back()) {
+        size_t size = std::max(sizes.back() * 2, bytes + alignment);
+        blocks.push_back((unsigned char*)_mm_malloc(size, 64));
+        sizes.push_back(size);
+        capacity += size;
+        aligned = 0;
+    }
+    offset = aligned + bytes;
+    used += bytes;
+    AllocStats::Allocated(AllocTag::Frame, bytes);
+    return blocks.back() + aligned;
+}
+
+// 帧结束重置（本帧用过多个块时合并为一个足够大的块，之后的帧不再追加）
+void FrameArena::Reset() {
+    peak = std::max(peak, used);
+    if (used) AllocStats::Freed(AllocTag::Frame, used); // 本帧的临时分配整体释放
+    if (blocks.size() > 1) {
+        for (auto block : blocks) _mm_free(block);
+        blocks.assign(1, (unsigned char*)_mm_malloc(capacity, 64));
+        sizes.assign(1, capacity);
+    }
+    offset = 0;
+    used = 0;
+}
+
+#pragma endregion
+
+
+// ====================== Jobs 并行任务 ======================
+#pragma region Jobs
+
+// 简单线程池（主线程也参与执行，按批次领取任务区间）
+class Jobs {
+public:
+    // 把[0, count)切成不小于minBatch的区间并行执行fn(begin, end)，返回时全部执行完毕
+    static void ParallelFor(int count, int minBatch, const std::function<void(int, int)>& fn);
+    static int WorkerCount(); // 参与执行的线程数（含主线程）
+private:
+    static void Init();
+    static void WorkerLoop();
+    static void RunBatches(const std::function<void(int, int)>& fn, int batch, int count);
+    static std::vector<std::thread> workers;
+    static std::mutex mutex;
+    static std::condition_variable wake, done;
+    // 以下任务描述只在持锁时读写；工作线程加入时连同代数一起拷贝
+    static const std::function<void(int, int)>* task;
+    static int batch, taskCount, active;
+    static unsigned generation;
+    static bool open;     // 当前任务仍接受加入（主线程收尾时关闭，迟到的线程不会碰到下一次任务的计数器）
+    static std::atomic<int> next, remaining;
+    static thread_local bool insideJob;
+};
+
+// 静态成员初始化
+std::vector<std::thread> Jobs::workers;
+std::mutex Jobs::mutex;
+std::condition_variable Jobs::wake, Jobs::done;
+const std::function<void(int, int)>* Jobs::task = nullptr;
+std::atomic<int> Jobs::next(0), Jobs::remaining(0);
+int Jobs::batch = 1;
+int Jobs::taskCount = 0;
+int Jobs::active = 0;   // 正在执行当前任务的工作线程数
+unsigned Jobs::generation = 0;
+bool Jobs::open = false;
+thread_local bool Jobs::insideJob = false;
+
+// 创建工作线程（数量为硬件线程数-1，主线程补足最后一个）
+void Jobs::Init() {
+    unsigned n = std::thread::hardware_concurrency();
+    for (unsigned i = 1; i < (n > 1 ? n : 1); i++) {
+        workers.emplace_back(WorkerLoop);
+        workers.back().detach(); // 与进程同生命周期
+    }
+}
+
+int Jobs::WorkerCount() {
+    if (workers.empty()) Init();
+    return (int)workers.size() + 1;
+}
+
+// 领取并执行批次，直到本次任务没有剩余区间
+void Jobs::RunBatches(const std::function<void(int, int)>& fn, int batch, int count) {
+    insideJob = true;
+    for (;;) {
+        int begin = next.fetch_add(batch);
+        if (begin >= count) break;
+        int end = std::min(begin + batch, count);
+        fn(begin, end);
+        remaining.fetch_sub(end - begin);
+    }
+    insideJob = false;
+}
+
+// 工作线程循环（等待新任务）
+void Jobs::WorkerLoop() {
+    unsigned seen = 0;
+    for (;;) {
+        const std::function<void(int, int)>* fn;
+        int size, count;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return open && generation != seen; });
+            seen = generation;
+            fn = task;
+            size = batch;
+            count = taskCount;
+            active++; // 主线程会等所有参与者退出后才关闭本次任务，计数器在此之前不会被重置
+        }
+        RunBatches(*fn, size, count);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active == 0) done.notify_all();
+    }
+}
+
+void Jobs::ParallelFor(int count, int minBatch, const std::function<void(int, int)>& fn) {
+    if (count <= 0) return;
+    int threads = WorkerCount();
+    // 数据量太小或在任务内部嵌套调用时直接在当前线程执行
+    if (insideJob || threads == 1 || count <= minBatch) {
+        fn(0, count);
+        return;
+    }
+    int size = std::max(minBatch, (count + threads * 4 - 1) / (threads * 4)); // 每线程约4批，兼顾负载均衡
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &fn;
+        batch = size;
+        remaining = count;
+        taskCount = count;
+        next = 0;
+        generation++;
+        open = true;
+    }
+    wake.notify_all();
+    RunBatches(fn, size, count);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [] { return remaining.load() == 0 && active == 0; });
+    open = false; // 与判断在同一次持锁内：之后被唤醒的线程只能等下一次任务
+}
+
+#pragma endregion
+
+
+// ====================== Vfs 打包资源与虚拟文件系统 ======================
+#pragma region Vfs
+
+// 档案格式（小端）：头部 | 条目表（按路径哈希排序）| 路径字符串 | 数据
+// 未压缩的条目按4K对齐，映射后直接指向档案内容（零拷贝）；压缩条目为LZ4块格式
+struct PakHeader {
+    char magic[4];                       // "APAK"
+    unsigned int version;
+    unsigned int entryCount;
+    unsigned int reserved;
+    unsigned long long tableOffset, namesOffset;
+};
+struct PakEntry {
+    unsigned long long hash;             // 规范化路径的FNV-1a哈希
+    unsigned long long offset;           // 数据在档案中的偏移
+    unsigned long long size;             // 原始大小
+    unsigned long long packed;           // 压缩后大小（0表示未压缩）
+    unsigned int nameOffset, nameLength; // 路径在字符串区中的位置
+};
+static_assert(sizeof(PakHeader) == 32 && sizeof(PakEntry) == 40, "pak layout");
+
+// 读到的文件内容：映射中的条目直接指向档案，否则放在storage中（不可复制）
+class VfsFile {
+public:
+    VfsFile() = default;
+    VfsFile(const VfsFile&) = delete;
+    VfsFile& operator=(const VfsFile&) = delete;
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::vector<unsigned char> storage;
+    string Text() const { return data ? string((const char*)data, size) : string(); }
+};
+
+// 解码后的图片像素（stbi分配，用stbi_image_free释放）
+struct DecodedImage {
+    unsigned char* pixels = nullptr;
+    int width = 0, height = 0, channels = 0;
+};
+
+// LZ4块格式编解码（打包工具压缩，运行时解压）
+class Lz4 {
+public:
+    static void Compress(const unsigned char* src, size_t size, std::vector<unsigned char>& out);
+    static bool Decompress(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstSize);
+private:
+    static void PutLength(std::vector<unsigned char>& out, size_t length);
+    static const int hashBits = 16;
+    static const size_t minMatch = 4, matchLimit = 12, lastLiterals = 5, maxOffset = 65535;
+};
+
+// 虚拟文件系统：先查挂载的档案，没有时（开发期）回退到散文件
+class Vfs {
+public:
+    static bool looseFallback;            // 档案中找不到时读取磁盘上的散文件（挂载成功时关闭，开发期需要可在挂载后打开）
+    // 映射档案；root为档案对应的目录，current为相对路径的基准目录
+    static bool Mount(const string& archive, const string& root, const string& current);
+    static void Unmount();
+    static bool Mounted() { return base != nullptr; }
+    static string Canonical(const string& path);  // '/'分隔、小写、解析.和..
+    static string Normalize(const string& path);  // 档案中的键：相对current展开并去掉root前缀
+    static bool Exists(const string& path);
+    static size_t Size(const string& path);
+    static bool Read(const string& path, VfsFile& out);
+    static bool ReadRange(const string& path, size_t offset, size_t size, void* dst);
+    // 未压缩条目的一段在映射中的地址（零拷贝），否则返回nullptr
+    static const unsigned char* Direct(const string& path, size_t offset, size_t size);
+    static size_t Prefetch(const string& path);   // 预读进页缓存，返回字节数
+    static bool DecodeImage(const string& path, DecodedImage& out); // 读取并解码图片（可在后台线程调用）
+    // 主线程：后台线程预先解码好的图片按Normalize的键暂存，LoadImage优先取用；ClearStaged释放没用上的
+    static void Stage(const string& key, const DecodedImage& image);
+    static void ClearStaged();
+    static bool LoadImage(const string& path, DecodedImage& out);
+    static unsigned int LoadTexture(const string& file, const string& directory); // 替代TextureFromFile（增加一次引用）
+    static bool ReleaseTexture(unsigned int id);  // 引用归零时删除纹理；不是这里加载的返回false
+    static unsigned int SharedTexture(const string& file, const string& directory); // 已加载则不加引用直接返回
+    static size_t textureBytes;                   // 已加载纹理的显存（含mip链）
+    static unsigned int LoadCubemap(const vector<string>& faces);                 // 替代loadCubemap
+    static void OnGUI();
+    static std::atomic<long long> archiveReads, looseReads, misses, decompressedBytes;
+private:
+    static const PakEntry* Find(const string& key);
+    static bool Extract(const PakEntry& entry, unsigned char* dst);
+    static string LoosePath(const string& path);
+    static const unsigned char* base;
+    static size_t mappedSize;
+    static const PakEntry* entries;
+    static const char* names;
+    static unsigned int entryCount;
+    static string archivePath, root, current;
+    struct TextureEntry {
+        unsigned int id;
+        int refs;
+        size_t bytes;
+    };
+    static std::unordered_map<string, TextureEntry> textures;
+    static std::unordered_map<unsigned int, string> textureKeys; // 纹理ID -> 路径，释放时反查
+    static std::unordered_map<string, DecodedImage> staged;
+#ifdef _WIN32
+    static HANDLE fileHandle, mappingHandle;
+#else
+    static int fileDescriptor;
+#endif
+};
+
+// 打包工具：把目录下的所有文件写成一个档案
+class ArchivePacker {
+public:
+    static bool Pack(const string& directory, const string& archive);
+    static std::vector<string> storedExtensions; // 本身已压缩或需要随机读取的格式不再压缩
+    static float minSaving;                      // 压缩至少节省这个比例才保存压缩结果
+    static const size_t alignment = 4096;
+};
+
+// Assimp读取适配：模型及其引用的文件都从Vfs读取
+class VfsIOStream : public Assimp::IOStream {
+public:
+    VfsIOStream() = default;
+    size_t Read(void* buffer, size_t size, size_t count) override;
+    size_t Write(const void*, size_t, size_t) override { return 0; }
+    aiReturn Seek(size_t offset, aiOrigin origin) override;
+    size_t Tell() const override { return position; }
+    size_t FileSize() const override { return file.size; }
+    void Flush() override {}
+    VfsFile file;
+private:
+    size_t position = 0;
+};
+
+class VfsIOSystem : public Assimp::IOSystem {
+public:
+    bool Exists(const char* file) const override { return Vfs::Exists(file); }
+    char getOsSeparator() const override { return '/'; }
+    Assimp::IOStream* Open(const char* file, const char* mode = "rb") override;
+    void Close(Assimp::IOStream* stream) override { delete stream; }
+};
+
+// 静态成员初始化
+bool Vfs::looseFallback = true;
+std::atomic<long long> Vfs::archiveReads(0), Vfs::looseReads(0), Vfs::misses(0), Vfs::decompressedBytes(0);
+const unsigned char* Vfs::base = nullptr;
+size_t Vfs::mappedSize = 0;
+const PakEntry* Vfs::entries = nullptr;
+const char* Vfs::names = nullptr;
+unsigned int Vfs::entryCount = 0;
+string Vfs::archivePath, Vfs::root, Vfs::current;
+std::unordered_map<string, Vfs::TextureEntry> Vfs::textures;
+std::unordered_map<unsigned int, string> Vfs::textureKeys;
+size_t Vfs::textureBytes = 0;
+std::unordered_map<string, DecodedImage> Vfs::staged;
+#ifdef _WIN32
+HANDLE Vfs::fileHandle = INVALID_HANDLE_VALUE, Vfs::mappingHandle = nullptr;
+#else
+int Vfs::fileDescriptor = -1;
+#endif
+std::vector<string> ArchivePacker::storedExtensions = { ".ktx2", ".png", ".jpg", ".jpeg" };
+float ArchivePacker::minSaving = 0.1f;
+
+static unsigned long long PathHash(const string& key) {
+    unsigned long long hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static unsigned int Read32(const unsigned char* p) {
+    unsigned int v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// 长度超过15的部分用连续的255字节表示
+void Lz4::PutLength(std::vector<unsigned char>& out, size_t length) {
+    for (; length >= 255; length -= 255) out.push_back(255);
+    out.push_back((unsigned char)length);
+}
+
+// 贪心哈希匹配（离线打包用，每个哈希槽只保留最近的位置）
+void Lz4::Compress(const unsigned char* src, size_t size, std::vector<unsigned char>& out) {
+    out.clear();
+    out.reserve(size + size / 255 + 16);
+    std::vector<unsigned int> table((size_t)1 << hashBits, 0);
+    size_t anchor = 0, i = 0;
+    // 格式限制：最后一个匹配至少在结尾前12字节开始，最后5字节必须是字面量
+    size_t limit = size > matchLimit ? size - matchLimit : 0, matchEnd = size > lastLiterals ? size - lastLiterals : 0;
+    while (i < limit) {
+        unsigned int sequence = Read32(src + i);
+        unsigned int h = (sequence * 2654435761u) >> (32 - hashBits);
+        size_t ref = table[h];
+        table[h] = (unsigned int)i;
+        if (ref >= i || i - ref > maxOffset || Read32(src + ref) != sequence) {
+            i++;
+            continue;
+        }
+        size_t length = minMatch;
+        while (i + length < matchEnd && src[ref + length] == src[i + length]) length++;
+        while (i > anchor && ref > 0 && src[i - 1] == src[ref - 1]) { i--; ref--; length++; } // 向前扩展
+        size_t literals = i - anchor, matchCode = length - minMatch;
+        out.push_back((unsigned char)((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(matchCode, 15)));
+        if (literals >= 15) PutLength(out, literals - 15);
+        out.insert(out.end(), src + anchor, src + i);
+        out.push_back((unsigned char)((i - ref) & 255));
+        out.push_back((unsigned char)((i - ref) >> 8));
+        if (matchCode >= 15) PutLength(out, matchCode - 15);
+        i += length;
+        anchor = i;
+    }
+    size_t literals = size - anchor; // 最后一段只有字面量
+    out.push_back((unsigned char)(std::min<size_t>(literals, 15) << 4));
+    if (literals >= 15) PutLength(out, literals - 15);
+    out.insert(out.end(), src + anchor, src + size);
+}
+
+// 带边界检查的解码（档案损坏时返回false而不是越界）
+bool Lz4::Decompress(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstSize) {
+    size_t ip = 0, op = 0;
+    auto readLength = [&](size_t& length) {
+        unsigned char b;
+        do {
+            if (ip >= srcSize) return false;
+            b = src[ip++];
+            length += b;
+        } while (b == 255);
+        return true;
+    };
+    while (ip < srcSize) {
+        unsigned int token = src[ip++];
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(literals)) return false;
+        if (literals > srcSize - ip || literals > dstSize - op) return false;
+        if (literals) memcpy(dst + op, src + ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == srcSize) break;
+        if (srcSize - ip < 2) return false;
+        size_t offset = src[ip] | ((size_t)src[ip + 1] << 8);
+        ip += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(length)) return false;
+        length += minMatch;
+        if (offset == 0 || offset > op || length > dstSize - op) return false;
+        const unsigned char* match = dst + op - offset;
+        if (offset >= length) memcpy(dst + op, match, length);
+        else for (size_t k = 0; k < length; k++) dst[op + k] = match[k]; // 重叠时逐字节复制
+        op += length;
+    }
+    return op == dstSize;
+}
+
+string Vfs::Canonical(const string& path) {
+    string p = path;
+    for (char& c : p) c = c == '\\' ? '/' : (char)std::tolower((unsigned char)c);
+    std::vector<string> parts;
+    size_t start = 0;
+    while (start <= p.size()) {
+        size_t end = p.find('/', start);
+        if (end == string::npos) end = p.size();
+        string part = p.substr(start, end - start);
+        if (part == "..") {
+            if (!parts.empty() && parts.back() != "..") parts.pop_back();
+            else parts.push_back(part);
+        } else if (!part.empty() && part != ".") {
+            parts.push_back(part);
+        }
+        start = end + 1;
+    }
+    string result = !p.empty() && p[0] == '/' ? "/" : "";
+    for (size_t i = 0; i < parts.size(); i++) result += (i ? "/" : "") + parts[i];
+    return result;
+}
+
+string Vfs::Normalize(const string& path) {
+    bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+    string key = Canonical(absolute || current.empty() ? path : current + '/' + path);
+    if (!root.empty() && key.size() > root.size() && key.compare(0, root.size(), root) == 0 && key[root.size()] == '/')
+        key = key.substr(root.size() + 1);
+    return key;
+}
+
+// 磁盘上的路径只统一分隔符（散文件在大小写敏感的系统上保留原样）
+string Vfs::LoosePath(const string& path) {
+    string p = path;
+#ifndef _WIN32
+    std::replace(p.begin(), p.end(), '\\', '/');
+#endif
+    return p;
+}
+
+bool Vfs::Mount(const string& archive, const string& rootDirectory, const string& currentDirectory) {
+    Unmount();
+    root = Canonical(rootDirectory);
+    current = Canonical(currentDirectory);
+    size_t size = 0;
+#ifdef _WIN32
+    fileHandle = CreateFileA(archive.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    LARGE_INTEGER fileSize;
+    if (fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &fileSize)) {
+        std::cout << "Vfs: no archive " << archive << ", reading loose files" << std::endl;
+        Unmount();
+        return false;
+    }
+    size = (size_t)fileSize.QuadPart;
+    mappingHandle = size ? CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    base = mappingHandle ? (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+    fileDescriptor = open(archive.c_str(), O_RDONLY);
+    struct stat info;
+    if (fileDescriptor < 0 || fstat(fileDescriptor, &info) != 0) {
+        std::cout << "Vfs: no archive " << archive << ", reading loose files" << std::endl;
+        Unmount();
+        return false;
+    }
+    size = (size_t)info.st_size;
+    void* view = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0) : MAP_FAILED;
+    base = view != MAP_FAILED ? (const unsigned char*)view : nullptr;
+#endif
+    mappedSize = base ? size : 0;
+    const PakHeader* header = (const PakHeader*)base;
+    // 头部：各区间都在文件内（先比较再相减，避免偏移量很大时溢出回绕），条目表按8字节对齐
+    bool valid = base && size >= sizeof(PakHeader) && memcmp(header->magic, "APAK", 4) == 0 && header->version == 1
+        && header->tableOffset <= size && header->tableOffset % 8 == 0
+        && header->entryCount <= (size - header->tableOffset) / sizeof(PakEntry) && header->namesOffset <= size;
+    // 条目：路径和数据都在文件内、按哈希排序（Find二分查找依赖它）、哈希与路径一致
+    for (unsigned int i = 0; valid && i < header->entryCount; i++) {
+        const PakEntry& entry = ((const PakEntry*)(base + header->tableOffset))[i];
+        unsigned long long stored = entry.packed ? entry.packed : entry.size;
+        valid = (unsigned long long)entry.nameOffset + entry.nameLength <= size - header->namesOffset
+            && entry.offset <= size && stored <= size - entry.offset
+            && (i == 0 || ((const PakEntry*)(base + header->tableOffset))[i - 1].hash <= entry.hash)
+            && PathHash(string((const char*)base + header->namesOffset + entry.nameOffset, entry.nameLength)) == entry.hash;
+        if (!valid) std::cout << "Vfs: bad entry " << i << " in " << archive << std::endl;
+    }
+    if (!valid) {
+        std::cout << "Vfs: invalid archive " << archive << std::endl;
+        Unmount();
+        return false;
+    }
+    entries = (const PakEntry*)(base + header->tableOffset);
+    names = (const char*)(base + header->namesOffset);
+    entryCount = header->entryCount;
+    archivePath = archive;
+    looseFallback = false; // 发布版只读档案，缺失的文件不会悄悄从磁盘读取
+    std::cout << "Vfs: mounted " << archive << " (" << entryCount << " entries)" << std::endl;
+    return true;
+}
+
+void Vfs::Unmount() {
+#ifdef _WIN32
+    if (base) UnmapViewOfFile(base);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (base) munmap((void*)base, mappedSize);
+    if (fileDescriptor >= 0) close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    base = nullptr;
+    mappedSize = 0;
+    entries = nullptr;
+    names = nullptr;
+    entryCount = 0;
+    archivePath.clear();
+}
+
+// 哈希二分查找，同哈希的条目再比较路径
+const PakEntry* Vfs::Find(const string& key) {
+    if (!base) return nullptr;
+    unsigned long long hash = PathHash(key);
+    const PakEntry* end = entries + entryCount;
+    const PakEntry* entry = std::lower_bound(entries, end, hash,
+        [](const PakEntry& e, unsigned long long h) { return e.hash < h; });
+    for (; entry != end && entry->hash == hash; entry++)
+        if (entry->nameLength == key.size() && memcmp(names + entry->nameOffset, key.data(), key.size()) == 0)
+            return entry;
+    return nullptr;
+}
+
+bool Vfs::Extract(const PakEntry& entry, unsigned char* dst) {
+    if (entry.offset + (entry.packed ? entry.packed : entry.size) > mappedSize) return false;
+    if (!entry.packed) {
+        memcpy(dst, base + entry.offset, (size_t)entry.size);
+        return true;
+    }
+    decompressedBytes += (long long)entry.size;
+    return Lz4::Decompress(base + entry.offset, (size_t)entry.packed, dst, (size_t)entry.size);
+}
+
+bool Vfs::Exists(const string& path) {
+    if (Find(Normalize(path))) return true;
+    return (!base || looseFallback) && std::ifstream(LoosePath(path), std::ios::binary).good();
+}
+
+size_t Vfs::Size(const string& path) {
+    if (const PakEntry* entry = Find(Normalize(path))) return (size_t)entry->size;
+    if (base && !looseFallback) return 0;
+    std::ifstream file(LoosePath(path), std::ios::binary | std::ios::ate);
+    return file.good() ? (size_t)file.tellg() : 0;
+}
+
+bool Vfs::Read(const string& path, VfsFile& out) {
+    out.storage.clear();
+    out.data = nullptr;
+    out.size = 0;
+    out.mapped = false;
+    if (const PakEntry* entry = Find(Normalize(path))) {
+        archiveReads++;
+        out.size = (size_t)entry->size;
+        if (!entry->packed && entry->offset + entry->size <= mappedSize) {
+            out.data = base + entry->offset;
+            out.mapped = true;
+            return true;
+        }
+        out.storage.resize(out.size);
+        if (!Extract(*entry, out.storage.data())) {
+            std::cout << "Vfs: corrupt entry " << path << std::endl;
+            out.size = 0;
+            return false;
+        }
+        out.data = out.storage.data();
+        return true;
+    }
+    if (base && !looseFallback) {
+        misses++;
+        return false;
+    }
+    std::ifstream file(LoosePath(path), std::ios::binary | std::ios::ate);
+    if (!file.good()) {
+        misses++;
+        return false;
+    }
+    looseReads++;
+    out.storage.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read((char*)out.storage.data(), out.storage.size());
+    out.data = out.storage.data();
+    out.size = out.storage.size();
+    return (bool)file;
+}
+
+const unsigned char* Vfs::Direct(const string& path, size_t offset, size_t size) {
+    const PakEntry* entry = Find(Normalize(path));
+    if (!entry || entry->packed || offset + size > entry->size || entry->offset + entry->size > mappedSize) return nullptr;
+    archiveReads++;
+    return base + entry->offset + offset;
+}
+
+bool Vfs::ReadRange(const string& path, size_t offset, size_t size, void* dst) {
+    if (const PakEntry* entry = Find(Normalize(path))) {
+        if (offset + size > entry->size) return false;
+        archiveReads++;
+        if (!entry->packed) {
+            if (entry->offset + entry->size > mappedSize) return false;
+            memcpy(dst, base + entry->offset + offset, size);
+            return true;
+        }
+        std::vector<unsigned char> whole((size_t)entry->size); // 压缩条目只能整体解压
+        if (!Extract(*entry, whole.data())) return false;
+        memcpy(dst, whole.data() + offset, size);
+        return true;
+    }
+    if (base && !looseFallback) return false;
+    std::ifstream file(LoosePath(path), std::ios::binary);
+    file.seekg((std::streamoff)offset);
+    file.read((char*)dst, size);
+    if (file) looseReads++;
+    return (bool)file;
+}
+
+// 映射中的条目逐页触碰，散文件按1MB块读一遍
+size_t Vfs::Prefetch(const string& path) {
+    if (const PakEntry* entry = Find(Normalize(path))) {
+        size_t bytes = (size_t)(entry->packed ? entry->packed : entry->size);
+        if (entry->offset + bytes > mappedSize) return 0;
+        unsigned int sum = 0;
+        for (size_t i = 0; i < bytes; i += 4096) sum += base[entry->offset + i];
+        volatile unsigned int sink = sum;
+        (void)sink;
+        return bytes;
+    }
+    if (base && !looseFallback) return 0;
+    std::ifstream file(LoosePath(path), std::ios::binary);
+    std::vector<char> chunk(1 << 20);
+    size_t bytes = 0;
+    while (file.read(chunk.data(), chunk.size()) || file.gcount() > 0)
+        bytes += (size_t)file.gcount();
+    return bytes;
+}
+
+// 加载2D纹理（同一路径只加载一次，按引用计数共享）
+bool Vfs::DecodeImage(const string& path, DecodedImage& out) {
+    VfsFile source;
+    if (!Read(path, source)) return false;
+    out.pixels = stbi_load_from_memory(source.data, (int)source.size, &out.width, &out.height, &out.channels, 0);
+    return out.pixels != nullptr;
+}
+
+void Vfs::Stage(const string& key, const DecodedImage& image) {
+    auto found = staged.find(key);
+    if (found != staged.end()) stbi_image_free(found->second.pixels);
+    staged[key] = image;
+}
+
+void Vfs::ClearStaged() {
+    for (auto& image : staged) stbi_image_free(image.second.pixels);
+    staged.clear();
+}
+
+bool Vfs::LoadImage(const string& path, DecodedImage& out) {
+    auto found = staged.find(Normalize(path));
+    if (found == staged.end()) return DecodeImage(path, out);
+    out = found->second; // 交给调用者释放
+    staged.erase(found);
+    return true;
+}
+
+unsigned int Vfs::LoadTexture(const string& file, const string& directory) {
+    string path = directory.empty() ? file : directory + '\\' + file;
+    string key = Normalize(path);
+    auto found = textures.find(key);
+    if (found != textures.end()) {
+        found->second.refs++;
+        return found->second.id;
+    }
+    DecodedImage image;
+    if (!LoadImage(path, image)) {
+        std::cout << "Vfs: failed to load texture " << path << std::endl;
+        return 0;
+    }
+    unsigned char* data = image.pixels;
+    int width = image.width, height = image.height, channels = image.channels;
+    GLenum format = channels == 1 ? GL_RED : channels == 3 ? GL_RGB : GL_RGBA;
+    unsigned int id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // RGB图片的行不一定4字节对齐
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    stbi_image_free(data);
+    size_t bytes = (size_t)width * height * channels;
+    bytes += bytes / 3; // mip链约为基础层的1/3
+    textures[key] = TextureEntry{ id, 1, bytes };
+    textureKeys[id] = key;
+    textureBytes += bytes;
+    return id;
+}
+
+bool Vfs::ReleaseTexture(unsigned int id) {
+    auto key = textureKeys.find(id);
+    if (key == textureKeys.end()) return false;
+    auto found = textures.find(key->second);
+    if (--found->second.refs > 0) return true;
+    textureBytes -= found->second.bytes;
+    glDeleteTextures(1, &id);
+    textures.erase(found);
+    textureKeys.erase(key);
+    return true;
+}
+
+// 长期持有路径而不持有ID的使用者（如BoxMaterial每次绘制查询）：已加载时不增加引用
+unsigned int Vfs::SharedTexture(const string& file, const string& directory) {
+    auto found = textures.find(Normalize(directory.empty() ? file : directory + '\\' + file));
+    return found != textures.end() ? found->second.id : LoadTexture(file, directory);
+}
+
+// 加载立方体贴图（六个面按+X,-X,+Y,-Y,+Z,-Z顺序）
+unsigned int Vfs::LoadCubemap(const vector<string>& faces) {
+    unsigned int id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < faces.size(); i++) {
+        VfsFile source;
+        int width = 0, height = 0, channels = 0;
+        unsigned char* data = Read(faces[i], source)
+            ? stbi_load_from_memory(source.data, (int)source.size, &width, &height, &channels, 0) : nullptr;
+        if (!data) {
+            std::cout << "Vfs: failed to load cubemap face " << faces[i] << std::endl;
+            continue;
+        }
+        GLenum format = channels == 1 ? GL_RED : channels == 3 ? GL_RGB : GL_RGBA;
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum)i, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        stbi_image_free(data);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return id;
+}
+
+// ImGui 调试界面（显示档案与读取统计）
+void Vfs::OnGUI() {
+    if (ImGui::TreeNode("Vfs")) {
+        if (base) ImGui::Text("archive: %s  entries: %u  mapped: %.1f MB", archivePath.c_str(), entryCount,
+            mappedSize / (1024.0f * 1024.0f));
+        else ImGui::Text("archive: none (loose files)");
+        ImGui::Checkbox("LooseFallback", &looseFallback);
+        ImGui::Text("archive reads: %lld  loose reads: %lld  misses: %lld", archiveReads.load(), looseReads.load(), misses.load());
+        ImGui::Text("decompressed: %.1f MB  textures: %d (%.1f MB)", decompressedBytes.load() / (1024.0f * 1024.0f),
+            (int)textures.size(), textureBytes / (1024.0f * 1024.0f));
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+// 打包：路径按Canonical规范化后作为键，条目表按哈希排序
+bool ArchivePacker::Pack(const string& directory, const string& archive) {
+    namespace fs = std::filesystem;
+    struct Item {
+        string key, path;
+        PakEntry entry;
+        std::vector<unsigned char> packed; // 压缩后的数据（未压缩条目写入时再读原文件）
+    };
+    std::vector<Item> items;
+    std::error_code error, ignored;
+    fs::path archiveFile = fs::absolute(archive, ignored);
+    for (fs::recursive_directory_iterator it(directory, error), end; it != end; it.increment(error)) {
+        if (error) break;
+        if (!it->is_regular_file() || fs::equivalent(it->path(), archiveFile, ignored)) continue;
+        Item item;
+        item.path = it->path().string();
+        item.key = Vfs::Canonical(fs::relative(it->path(), directory, ignored).generic_string());
+        string extension = Vfs::Canonical(it->path().extension().string());
+        std::ifstream file(item.path, std::ios::binary | std::ios::ate);
+        if (!file) { // 打不开时tellg返回-1，不能拿来分配缓冲
+            std::cout << "ArchivePacker: failed to open " << item.path << std::endl;
+            return false;
+        }
+        std::vector<unsigned char> data((size_t)file.tellg());
+        file.seekg(0);
+        file.read((char*)data.data(), data.size());
+        if (!file) {
+            std::cout << "ArchivePacker: failed to read " << item.path << std::endl;
+            return false;
+        }
+        item.entry = PakEntry{ PathHash(item.key), 0, data.size(), 0, 0, (unsigned int)item.key.size() };
+        bool store = std::find(storedExtensions.begin(), storedExtensions.end(), extension) != storedExtensions.end();
+        if (!store && !data.empty()) {
+            Lz4::Compress(data.data(), data.size(), item.packed);
+            if (item.packed.size() <= data.size() * (1.0f - minSaving)) item.entry.packed = item.packed.size();
+            else item.packed.clear();
+        }
+        items.push_back(std::move(item));
+    }
+    if (error) {
+        std::cout << "ArchivePacker: cannot read " << directory << " (" << error.message() << ")" << std::endl;
+        return false;
+    }
+    std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        return a.entry.hash != b.entry.hash ? a.entry.hash < b.entry.hash : a.key < b.key;
+    });
+
+    // 布局：头部、条目表、路径字符串，之后是数据（未压缩条目按4K对齐，压缩条目按16字节对齐）
+    PakHeader header = { { 'A', 'P', 'A', 'K' }, 1, (unsigned int)items.size(), 0, sizeof(PakHeader), 0 };
+    header.namesOffset = header.tableOffset + items.size() * sizeof(PakEntry);
+    string nameData;
+    for (auto& item : items) {
+        item.entry.nameOffset = (unsigned int)nameData.size();
+        nameData += item.key;
+    }
+    unsigned long long offset = header.namesOffset + nameData.size();
+    size_t packedCount = 0, totalSize = 0;
+    for (auto& item : items) {
+        unsigned long long align = item.entry.packed ? 16 : alignment;
+        offset = (offset + align - 1) / align * align;
+        item.entry.offset = offset;
+        offset += item.entry.packed ? item.entry.packed : item.entry.size;
+        packedCount += item.entry.packed ? 1 : 0;
+        totalSize += (size_t)item.entry.size;
+    }
+
+    std::ofstream file(archive, std::ios::binary);
+    file.write((const char*)&header, sizeof(header));
+    for (auto& item : items) file.write((const char*)&item.entry, sizeof(PakEntry));
+    file.write(nameData.data(), nameData.size());
+    std::vector<unsigned char> data;
+    for (auto& item : items) {
+        while ((unsigned long long)file.tellp() < item.entry.offset) file.put(0);
+        if (item.entry.packed) {
+            file.write((const char*)item.packed.data(), item.packed.size());
+            continue;
+        }
+        std::ifstream source(item.path, std::ios::binary);
+        data.resize((size_t)item.entry.size);
+        source.read((char*)data.data(), data.size());
+        file.write((const char*)data.data(), data.size());
+    }
+    std::cout << "ArchivePacker: " << items.size() << " files (" << packedCount << " compressed), "
+        << totalSize / 1024 << " KB -> " << offset / 1024 << " KB in " << archive << std::endl;
+    return (bool)file;
+}
+
+size_t VfsIOStream::Read(void* buffer, size_t size, size_t count) {
+    if (size == 0) return 0;
+    count = std::min(count, (file.size - position) / size);
+    memcpy(buffer, file.data + position, size * count);
+    position += size * count;
+    return count;
+}
+
+aiReturn VfsIOStream::Seek(size_t offset, aiOrigin origin) {
+    if (origin == aiOrigin_END && offset > file.size) return aiReturn_FAILURE;
+    size_t target = origin == aiOrigin_SET ? offset : origin == aiOrigin_CUR ? position + offset : file.size - offset; // 与Assimp的MemoryIOStream一致
+    if (target > file.size) return aiReturn_FAILURE;
+    position = target;
+    return aiReturn_SUCCESS;
+}
+
+Assimp::IOStream* VfsIOSystem::Open(const char* path, const char* mode) {
+    if (strchr(mode, 'w')) return nullptr; // 只读
+    VfsIOStream* stream = new VfsIOStream();
+    if (!Vfs::Read(path, stream->file)) {
+        delete stream;
+        return nullptr;
+    }
+    return stream;
+}
+
+#pragma endregion
+
+
 // ====================== MonoBehavior 行为脚本基类 ======================
 #pragma region Monobehavior ： Object
 
@@ -67,84 +1181,5643 @@ MonoBehavior::MonoBehavior() : Object("MonoBehavior_") {
     this->gameObject = nullptr; // 初始时无所属游戏对象
 }
 
-// 析构函数（虚析构，确保派生类资源释放）
-MonoBehavior::~MonoBehavior() {}
+// 析构函数（虚析构，确保派生类资源释放）
+MonoBehavior::~MonoBehavior() {}
+
+// 组件从按大小分级的内存池分配（虚析构保证delete时传入的是派生类的实际大小）
+void* MonoBehavior::operator new(size_t size) {
+    return PoolAllocator::Allocate(size, AllocTag::Components);
+}
+
+void MonoBehavior::operator delete(void * p, size_t size) {
+    PoolAllocator::Free(p, size, AllocTag::Components);
+}
+
+// 初始化逻辑（虚函数，派生类可重写）
+void MonoBehavior::Start() {}
+
+// 物理更新（虚函数，用于固定时间步逻辑）
+void MonoBehavior::RealUpdate() {}
+
+// 每帧更新（虚函数，随帧率调用）
+void MonoBehavior::Update() {}
+
+// ImGui 调试界面（虚函数，显示启用状态复选框）
+void MonoBehavior::OnGUI() const {
+    ImGui::Checkbox("Enable", (bool*)&enable); // 显示启用状态切换复选框
+}
+
+#pragma endregion
+
+
+// ====================== TransformBatch 变换批量更新 ======================
+#pragma region TransformBatch
+
+// AVX2内核的编译目标（GCC/Clang按函数开启AVX2+FMA，运行时再决定是否调用；MSVC无需额外选项）
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+// 运行时检测CPU（及操作系统）是否支持AVX2和FMA
+static bool CpuHasAVX2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0, osxsave = (info[2] & (1 << 27)) != 0;
+    if (!fma || !osxsave || (_xgetbv(0) & 6) != 6) return false; // 操作系统需保存YMM寄存器
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+// 变换的镜像字段（结构体数组 -> 数组结构体，每个字段一个连续数组）
+enum TransformField { TF_PX, TF_PY, TF_PZ, TF_RX, TF_RY, TF_RZ, TF_SX, TF_SY, TF_SZ, TF_PITCH, TF_YAW, TF_UX, TF_UY, TF_UZ, TF_COUNT };
+// 内核输出：模型矩阵前三列的xyz（第四列就是位置）和三个方向向量
+enum TransformOutput { TO_M00, TO_M01, TO_M02, TO_M10, TO_M11, TO_M12, TO_M20, TO_M21, TO_M22,
+    TO_FX, TO_FY, TO_FZ, TO_RX, TO_RY, TO_RZ, TO_UX, TO_UY, TO_UZ, TO_COUNT };
+
+// 批量内核：处理[begin, end)，数组长度已按8补齐
+typedef void(*TransformKernel)(float* const* in, float* const* out, int begin, int end);
+
+// 标量版本的闭式TRS（与 translate * scale * rotateX * rotateY * rotateZ 结果一致）
+static mat4 ComposeTRS(const vec3& position, const vec3& rotation, const vec3& scale) {
+    vec3 r = radians(rotation);
+    float sx = std::sin(r.x), cx = std::cos(r.x), sy = std::sin(r.y), cy = std::cos(r.y), sz = std::sin(r.z), cz = std::cos(r.z);
+    mat4 m;
+    m[0] = vec4(scale.x * cy * cz, scale.y * (cx * sz + sx * sy * cz), scale.z * (sx * sz - cx * sy * cz), 0);
+    m[1] = vec4(-scale.x * cy * sz, scale.y * (cx * cz - sx * sy * sz), scale.z * (sx * cz + cx * sy * sz), 0);
+    m[2] = vec4(scale.x * sy, -scale.y * sx * cy, scale.z * cx * cy, 0);
+    m[3] = vec4(position, 1);
+    return m;
+}
+
+// ---- SSE2（4路） ----
+
+// 向量sincos（Cephes的单精度多项式，按π/4分段并三段扩展精度约简）
+static inline void SinCos4(__m128 x, __m128* s, __m128* c) {
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+    __m128 sinSign = _mm_and_ps(x, signMask);
+    x = _mm_andnot_ps(signMask, x);
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f))); // x * 4/π
+    j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(j);
+    __m128 swapSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+    __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+    __m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+    sinSign = _mm_xor_ps(sinSign, swapSin);
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 pc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), z), _mm_set1_ps(-1.388731625493765e-3f));
+    pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(4.166664568298827e-2f));
+    pc = _mm_mul_ps(_mm_mul_ps(pc, z), z);
+    pc = _mm_add_ps(_mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1));
+    __m128 ps = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), z), _mm_set1_ps(8.3321608736e-3f));
+    ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(-1.6666654611e-1f));
+    ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, z), x), x);
+    __m128 sinV = _mm_or_ps(_mm_and_ps(polyMask, ps), _mm_andnot_ps(polyMask, pc));
+    __m128 cosV = _mm_or_ps(_mm_and_ps(polyMask, pc), _mm_andnot_ps(polyMask, ps));
+    *s = _mm_xor_ps(sinV, sinSign);
+    *c = _mm_xor_ps(cosV, cosSign);
+}
+
+static inline void Normalize4(__m128& x, __m128& y, __m128& z) {
+    __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+    x = _mm_div_ps(x, len);
+    y = _mm_div_ps(y, len);
+    z = _mm_div_ps(z, len);
+}
+
+static void TransformKernelSSE(float* const* in, float* const* out, int begin, int end) {
+    const __m128 toRadians = _mm_set1_ps(0.017453292519943295f);
+    for (int i = begin; i < end; i += 4) {
+        // 旋转矩阵 Rx*Ry*Rz 的闭式展开，行乘以对应缩放
+        __m128 sx, cx, sy, cy, sz, cz;
+        SinCos4(_mm_mul_ps(_mm_loadu_ps(in[TF_RX] + i), toRadians), &sx, &cx);
+        SinCos4(_mm_mul_ps(_mm_loadu_ps(in[TF_RY] + i), toRadians), &sy, &cy);
+        SinCos4(_mm_mul_ps(_mm_loadu_ps(in[TF_RZ] + i), toRadians), &sz, &cz);
+        __m128 kx = _mm_loadu_ps(in[TF_SX] + i), ky = _mm_loadu_ps(in[TF_SY] + i), kz = _mm_loadu_ps(in[TF_SZ] + i);
+        __m128 sxsy = _mm_mul_ps(sx, sy), cxsy = _mm_mul_ps(cx, sy);
+        _mm_storeu_ps(out[TO_M00] + i, _mm_mul_ps(kx, _mm_mul_ps(cy, cz)));
+        _mm_storeu_ps(out[TO_M01] + i, _mm_mul_ps(ky, _mm_add_ps(_mm_mul_ps(cx, sz), _mm_mul_ps(sxsy, cz))));
+        _mm_storeu_ps(out[TO_M02] + i, _mm_mul_ps(kz, _mm_sub_ps(_mm_mul_ps(sx, sz), _mm_mul_ps(cxsy, cz))));
+        _mm_storeu_ps(out[TO_M10] + i, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(kx, _mm_mul_ps(cy, sz))));
+        _mm_storeu_ps(out[TO_M11] + i, _mm_mul_ps(ky, _mm_sub_ps(_mm_mul_ps(cx, cz), _mm_mul_ps(sxsy, sz))));
+        _mm_storeu_ps(out[TO_M12] + i, _mm_mul_ps(kz, _mm_add_ps(_mm_mul_ps(sx, cz), _mm_mul_ps(cxsy, sz))));
+        _mm_storeu_ps(out[TO_M20] + i, _mm_mul_ps(kx, sy));
+        _mm_storeu_ps(out[TO_M21] + i, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(ky, _mm_mul_ps(sx, cy))));
+        _mm_storeu_ps(out[TO_M22] + i, _mm_mul_ps(kz, _mm_mul_ps(cx, cy)));
+
+        // 方向向量：Forward由俯仰/偏航得到，Right = Forward × WorldUp，Up = Forward × Right
+        __m128 sp, cp, sw, cw;
+        SinCos4(_mm_loadu_ps(in[TF_PITCH] + i), &sp, &cp);
+        SinCos4(_mm_loadu_ps(in[TF_YAW] + i), &sw, &cw);
+        __m128 fx = _mm_mul_ps(cp, sw), fy = sp, fz = _mm_mul_ps(cp, cw);
+        __m128 ux = _mm_loadu_ps(in[TF_UX] + i), uy = _mm_loadu_ps(in[TF_UY] + i), uz = _mm_loadu_ps(in[TF_UZ] + i);
+        __m128 rx = _mm_sub_ps(_mm_mul_ps(fy, uz), _mm_mul_ps(fz, uy));
+        __m128 ry = _mm_sub_ps(_mm_mul_ps(fz, ux), _mm_mul_ps(fx, uz));
+        __m128 rz = _mm_sub_ps(_mm_mul_ps(fx, uy), _mm_mul_ps(fy, ux));
+        Normalize4(rx, ry, rz);
+        __m128 vx = _mm_sub_ps(_mm_mul_ps(fy, rz), _mm_mul_ps(fz, ry));
+        __m128 vy = _mm_sub_ps(_mm_mul_ps(fz, rx), _mm_mul_ps(fx, rz));
+        __m128 vz = _mm_sub_ps(_mm_mul_ps(fx, ry), _mm_mul_ps(fy, rx));
+        Normalize4(vx, vy, vz);
+        _mm_storeu_ps(out[TO_FX] + i, fx); _mm_storeu_ps(out[TO_FY] + i, fy); _mm_storeu_ps(out[TO_FZ] + i, fz);
+        _mm_storeu_ps(out[TO_RX] + i, rx); _mm_storeu_ps(out[TO_RY] + i, ry); _mm_storeu_ps(out[TO_RZ] + i, rz);
+        _mm_storeu_ps(out[TO_UX] + i, vx); _mm_storeu_ps(out[TO_UY] + i, vy); _mm_storeu_ps(out[TO_UZ] + i, vz);
+    }
+}
+
+// ---- AVX2 + FMA（8路，与SSE版本逐项对应） ----
+
+TARGET_AVX2 static inline void SinCos8(__m256 x, __m256* s, __m256* c) {
+    const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32((int)0x80000000));
+    __m256 sinSign = _mm256_and_ps(x, signMask);
+    x = _mm256_andnot_ps(signMask, x);
+    __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f)));
+    j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+    __m256 y = _mm256_cvtepi32_ps(j);
+    __m256 swapSin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29));
+    __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+    __m256 polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+    sinSign = _mm256_xor_ps(sinSign, swapSin);
+    x = _mm256_fnmadd_ps(y, _mm256_set1_ps(0.78515625f), x);
+    x = _mm256_fnmadd_ps(y, _mm256_set1_ps(2.4187564849853515625e-4f), x);
+    x = _mm256_fnmadd_ps(y, _mm256_set1_ps(3.77489497744594108e-8f), x);
+    __m256 z = _mm256_mul_ps(x, x);
+    __m256 pc = _mm256_fmadd_ps(_mm256_set1_ps(2.443315711809948e-5f), z, _mm256_set1_ps(-1.388731625493765e-3f));
+    pc = _mm256_fmadd_ps(pc, z, _mm256_set1_ps(4.166664568298827e-2f));
+    pc = _mm256_mul_ps(_mm256_mul_ps(pc, z), z);
+    pc = _mm256_add_ps(_mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), pc), _mm256_set1_ps(1));
+    __m256 ps = _mm256_fmadd_ps(_mm256_set1_ps(-1.9515295891e-4f), z, _mm256_set1_ps(8.3321608736e-3f));
+    ps = _mm256_fmadd_ps(ps, z, _mm256_set1_ps(-1.6666654611e-1f));
+    ps = _mm256_fmadd_ps(_mm256_mul_ps(ps, z), x, x);
+    *s = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, polyMask), sinSign);
+    *c = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, polyMask), cosSign);
+}
+
+TARGET_AVX2 static inline void Normalize8(__m256& x, __m256& y, __m256& z) {
+    __m256 len = _mm256_sqrt_ps(_mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z))));
+    x = _mm256_div_ps(x, len);
+    y = _mm256_div_ps(y, len);
+    z = _mm256_div_ps(z, len);
+}
+
+TARGET_AVX2 static void TransformKernelAVX2(float* const* in, float* const* out, int begin, int end) {
+    const __m256 toRadians = _mm256_set1_ps(0.017453292519943295f);
+    for (int i = begin; i < end; i += 8) {
+        __m256 sx, cx, sy, cy, sz, cz;
+        SinCos8(_mm256_mul_ps(_mm256_loadu_ps(in[TF_RX] + i), toRadians), &sx, &cx);
+        SinCos8(_mm256_mul_ps(_mm256_loadu_ps(in[TF_RY] + i), toRadians), &sy, &cy);
+        SinCos8(_mm256_mul_ps(_mm256_loadu_ps(in[TF_RZ] + i), toRadians), &sz, &cz);
+        __m256 kx = _mm256_loadu_ps(in[TF_SX] + i), ky = _mm256_loadu_ps(in[TF_SY] + i), kz = _mm256_loadu_ps(in[TF_SZ] + i);
+        __m256 sxsy = _mm256_mul_ps(sx, sy), cxsy = _mm256_mul_ps(cx, sy);
+        _mm256_storeu_ps(out[TO_M00] + i, _mm256_mul_ps(kx, _mm256_mul_ps(cy, cz)));
+        _mm256_storeu_ps(out[TO_M01] + i, _mm256_mul_ps(ky, _mm256_fmadd_ps(cx, sz, _mm256_mul_ps(sxsy, cz))));
+        _mm256_storeu_ps(out[TO_M02] + i, _mm256_mul_ps(kz, _mm256_fmsub_ps(sx, sz, _mm256_mul_ps(cxsy, cz))));
+        _mm256_storeu_ps(out[TO_M10] + i, _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(kx, _mm256_mul_ps(cy, sz))));
+        _mm256_storeu_ps(out[TO_M11] + i, _mm256_mul_ps(ky, _mm256_fnmadd_ps(sxsy, sz, _mm256_mul_ps(cx, cz))));
+        _mm256_storeu_ps(out[TO_M12] + i, _mm256_mul_ps(kz, _mm256_fmadd_ps(cxsy, sz, _mm256_mul_ps(sx, cz))));
+        _mm256_storeu_ps(out[TO_M20] + i, _mm256_mul_ps(kx, sy));
+        _mm256_storeu_ps(out[TO_M21] + i, _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(ky, _mm256_mul_ps(sx, cy))));
+        _mm256_storeu_ps(out[TO_M22] + i, _mm256_mul_ps(kz, _mm256_mul_ps(cx, cy)));
+
+        __m256 sp, cp, sw, cw;
+        SinCos8(_mm256_loadu_ps(in[TF_PITCH] + i), &sp, &cp);
+        SinCos8(_mm256_loadu_ps(in[TF_YAW] + i), &sw, &cw);
+        __m256 fx = _mm256_mul_ps(cp, sw), fy = sp, fz = _mm256_mul_ps(cp, cw);
+        __m256 ux = _mm256_loadu_ps(in[TF_UX] + i), uy = _mm256_loadu_ps(in[TF_UY] + i), uz = _mm256_loadu_ps(in[TF_UZ] + i);
+        __m256 rx = _mm256_fmsub_ps(fy, uz, _mm256_mul_ps(fz, uy));
+        __m256 ry = _mm256_fmsub_ps(fz, ux, _mm256_mul_ps(fx, uz));
+        __m256 rz = _mm256_fmsub_ps(fx, uy, _mm256_mul_ps(fy, ux));
+        Normalize8(rx, ry, rz);
+        __m256 vx = _mm256_fmsub_ps(fy, rz, _mm256_mul_ps(fz, ry));
+        __m256 vy = _mm256_fmsub_ps(fz, rx, _mm256_mul_ps(fx, rz));
+        __m256 vz = _mm256_fmsub_ps(fx, ry, _mm256_mul_ps(fy, rx));
+        Normalize8(vx, vy, vz);
+        _mm256_storeu_ps(out[TO_FX] + i, fx); _mm256_storeu_ps(out[TO_FY] + i, fy); _mm256_storeu_ps(out[TO_FZ] + i, fz);
+        _mm256_storeu_ps(out[TO_RX] + i, rx); _mm256_storeu_ps(out[TO_RY] + i, ry); _mm256_storeu_ps(out[TO_RZ] + i, rz);
+        _mm256_storeu_ps(out[TO_UX] + i, vx); _mm256_storeu_ps(out[TO_UY] + i, vy); _mm256_storeu_ps(out[TO_UZ] + i, vz);
+    }
+}
+
+// 变换批量更新（Transform的字段仍是唯一数据源，这里维护其SoA镜像；
+// 每帧一次找出与镜像不同的变换，压缩成连续数组后由SIMD内核一次算出模型矩阵和方向向量）
+class TransformBatch {
+public:
+    static void Register(Transform* transform);     // Transform构造时加入
+    static void Unregister(Transform* transform);   // Transform析构时移除
+    static void Update();                           // 每帧第一次Transform::RealUpdate时执行
+    static void EndFrame();                         // RenderPipeline::RenderFrame结束时调用（帧边界）
+    static mat4 ModelMatrix(const Transform* transform); // 镜像未过期时直接返回缓存的矩阵
+    static bool BasisCurrent(const Transform* transform); // 方向向量是否已由本帧批量算出
+    static void TakeChanged(std::vector<Transform*>& out); // 取出上次调用以来位置/旋转/缩放变化过的变换（每个只出现一次）
+    static void OnGUI();
+    static const char* kernelName;
+    static int dirtyCount;
+private:
+    static void Read(const Transform* transform, float* v);
+    static void MarkChanged(int index);
+    static std::vector<Transform*> transforms;
+    static std::vector<Transform*> changed;        // 等待TakeChanged取走的变换
+    static std::vector<unsigned char> changedFlag; // 每个变换是否已在changed中
+    static std::vector<float> mirror[TF_COUNT];
+    static std::vector<mat4> matrices;
+    static TransformKernel kernel;
+    static int lanes;
+    static bool ran;
+};
+
+// 静态成员初始化
+const char* TransformBatch::kernelName = "";
+int TransformBatch::dirtyCount = 0;
+std::vector<Transform*> TransformBatch::transforms;
+std::vector<Transform*> TransformBatch::changed;
+std::vector<unsigned char> TransformBatch::changedFlag;
+std::vector<float> TransformBatch::mirror[TF_COUNT];
+std::vector<mat4> TransformBatch::matrices;
+TransformKernel TransformBatch::kernel = nullptr;
+int TransformBatch::lanes = 4;
+bool TransformBatch::ran = false;
+
+void TransformBatch::Read(const Transform * t, float * v) {
+    v[TF_PX] = t->position.x; v[TF_PY] = t->position.y; v[TF_PZ] = t->position.z;
+    v[TF_RX] = t->rotation.x; v[TF_RY] = t->rotation.y; v[TF_RZ] = t->rotation.z;
+    v[TF_SX] = t->scale.x; v[TF_SY] = t->scale.y; v[TF_SZ] = t->scale.z;
+    v[TF_PITCH] = t->Pitch; v[TF_YAW] = t->Yaw;
+    v[TF_UX] = t->WorldUp.x; v[TF_UY] = t->WorldUp.y; v[TF_UZ] = t->WorldUp.z;
+}
+
+void TransformBatch::Register(Transform * transform) {
+    transform->batchIndex = (int)transforms.size();
+    transforms.push_back(transform);
+    for (auto& field : mirror) field.push_back(NAN); // NaN与任何值都不相等，保证首帧被标记
+    matrices.push_back(mat4(1));
+    changedFlag.push_back(0);
+}
+
+void TransformBatch::Unregister(Transform * transform) {
+    int i = transform->batchIndex;
+    if (i < 0) return;
+    int last = (int)transforms.size() - 1;
+    transforms[i] = transforms[last]; // 与末尾交换删除
+    transforms[i]->batchIndex = i;
+    for (auto& field : mirror) {
+        field[i] = field[last];
+        field.pop_back();
+    }
+    matrices[i] = matrices[last];
+    if (changedFlag[i]) changed.erase(std::remove(changed.begin(), changed.end(), transform), changed.end());
+    changedFlag[i] = changedFlag[last];
+    transforms.pop_back();
+    matrices.pop_back();
+    changedFlag.pop_back();
+    transform->batchIndex = -1;
+}
+
+void TransformBatch::MarkChanged(int i) {
+    if (changedFlag[i]) return;
+    changedFlag[i] = 1;
+    changed.push_back(transforms[i]);
+}
+
+// 取走变化记录（记录跨帧保留到被取走为止，不会漏掉取之后、下一帧之前的改动）
+void TransformBatch::TakeChanged(std::vector<Transform*>& out) {
+    out.clear();
+    out.swap(changed);
+    for (auto t : out) changedFlag[t->batchIndex] = 0;
+}
+
+void TransformBatch::Update() {
+    if (ran) return;
+    ran = true;
+    if (!kernel) {
+        bool avx2 = CpuHasAVX2();
+        kernel = avx2 ? TransformKernelAVX2 : TransformKernelSSE;
+        kernelName = avx2 ? "AVX2" : "SSE2";
+        lanes = avx2 ? 8 : 4;
+    }
+
+    // 收集：与镜像比较，只把变化过的变换压缩到连续数组
+    int count = (int)transforms.size();
+    int* dirty = FrameArena::Allocate<int>(count + 1);
+    float v[TF_COUNT];
+    dirtyCount = 0;
+    for (int i = 0; i < count; i++) {
+        Read(transforms[i], v);
+        bool dirtied = false;
+        for (int f = 0; f < TF_COUNT; f++) {
+            if (mirror[f][i] != v[f]) {
+                dirtied = true;
+                if (f <= TF_SZ) MarkChanged(i); // 影响模型矩阵的字段
+                mirror[f][i] = v[f];
+            }
+        }
+        if (dirtied) dirty[dirtyCount++] = i;
+    }
+    if (dirtyCount == 0) return;
+
+    int padded = (dirtyCount + 7) & ~7; // 按8补齐，内核不需要处理尾部
+    float* in[TF_COUNT];
+    float* out[TO_COUNT];
+    for (int f = 0; f < TF_COUNT; f++) {
+        in[f] = FrameArena::Allocate<float>(padded);
+        for (int k = 0; k < dirtyCount; k++) in[f][k] = mirror[f][dirty[k]];
+        for (int k = dirtyCount; k < padded; k++) in[f][k] = f == TF_UY ? 1.0f : 0.0f; // 补齐的通道取合法值
+    }
+    for (int o = 0; o < TO_COUNT; o++) out[o] = FrameArena::Allocate<float>(padded);
+
+    // 计算：数量较多时按8个一组分给工作线程
+    int groups = padded / 8;
+    Jobs::ParallelFor(groups, 256, [&](int begin, int end) {
+        kernel(in, out, begin * 8, end * 8);
+    });
+
+    // 写回：模型矩阵进缓存，方向向量写回Transform
+    for (int k = 0; k < dirtyCount; k++) {
+        int i = dirty[k];
+        Transform* t = transforms[i];
+        mat4& m = matrices[i];
+        m[0] = vec4(out[TO_M00][k], out[TO_M01][k], out[TO_M02][k], 0);
+        m[1] = vec4(out[TO_M10][k], out[TO_M11][k], out[TO_M12][k], 0);
+        m[2] = vec4(out[TO_M20][k], out[TO_M21][k], out[TO_M22][k], 0);
+        m[3] = vec4(in[TF_PX][k], in[TF_PY][k], in[TF_PZ][k], 1);
+        t->Forward = vec3(out[TO_FX][k], out[TO_FY][k], out[TO_FZ][k]);
+        t->Right = vec3(out[TO_RX][k], out[TO_RY][k], out[TO_RZ][k]);
+        t->Up = vec3(out[TO_UX][k], out[TO_UY][k], out[TO_UZ][k]);
+    }
+}
+
+void TransformBatch::EndFrame() {
+    ran = false;
+}
+
+// 位置/旋转/缩放与镜像一致时返回缓存矩阵，否则（本帧批量之后被脚本改动）用标量闭式重算并刷新镜像
+mat4 TransformBatch::ModelMatrix(const Transform * t) {
+    int i = t->batchIndex;
+    if (i < 0) return ComposeTRS(t->position, t->rotation, t->scale);
+    float v[TF_COUNT];
+    Read(t, v);
+    bool current = true;
+    for (int f = TF_PX; f <= TF_SZ; f++)
+        current = current && mirror[f][i] == v[f];
+    if (!current) {
+        for (int f = TF_PX; f <= TF_SZ; f++) mirror[f][i] = v[f];
+        matrices[i] = ComposeTRS(t->position, t->rotation, t->scale);
+        MarkChanged(i);
+    }
+    return matrices[i];
+}
+
+bool TransformBatch::BasisCurrent(const Transform * t) {
+    int i = t->batchIndex;
+    return i >= 0 && mirror[TF_PITCH][i] == t->Pitch && mirror[TF_YAW][i] == t->Yaw
+        && mirror[TF_UX][i] == t->WorldUp.x && mirror[TF_UY][i] == t->WorldUp.y && mirror[TF_UZ][i] == t->WorldUp.z;
+}
+
+// ImGui 调试界面（显示所选内核和本帧更新数量）
+void TransformBatch::OnGUI() {
+    if (ImGui::TreeNode("TransformBatch")) {
+        ImGui::Text("kernel: %s (%d lanes)", kernelName, lanes);
+        ImGui::Text("transforms: %d  dirty: %d", (int)transforms.size(), dirtyCount);
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+#pragma endregion
+
+
+// ====================== Transform 变换组件 ======================
+#pragma region Transform : MonoBehavior
+
+// 平移操作（世界空间平移）
+void Transform::Translate(vec3 movement) {
+    position += movement; // 直接更新位置
+}
+
+// 获取模型矩阵（包含平移、旋转、缩放，支持世界矩阵叠加）
+// 等价于 world * translate * scale * rotateX * rotateY * rotateZ；局部矩阵由TransformBatch批量算好并缓存
+mat4 Transform::GetModelMaterix(mat4 world) const {
+    return world * TransformBatch::ModelMatrix(this);
+}
+
+// ImGui 调试界面（显示变换参数）
+void Transform::OnGUI() const {
+    MonoBehavior::OnGUI(); // 显示基类的启用状态复选框
+    // 拖动条显示位置、旋转、缩放参数（控件ID由SceneInspector的PushID区分，不再拼接字符串）
+    ImGui::DragFloat3("Position", (float*)&position, 0.5f, -500, 500);
+    ImGui::DragFloat3("Rotation", (float*)&rotation, 0.5f, -500, 500);
+    ImGui::DragFloat3("Scale", (float*)&scale, 0.01f, -100, 100);
+    // 显示相机相关的偏航角和俯仰角
+    ImGui::DragFloat("Yaw", (float*)&Yaw, 0.01f, -10, 10);
+    ImGui::DragFloat("Pitch", (float*)&Pitch, 0.01f, -10, 10);
+}
+
+// 物理更新（计算世界空间方向向量）
+void Transform::RealUpdate() {
+    MonoBehavior::RealUpdate();
+    // 每帧第一个Transform触发批量更新，所有变化过的变换一次算完
+    TransformBatch::Update();
+    if (TransformBatch::BasisCurrent(this)) return;
+    // 批量更新之后本帧又改了欧拉角，单独补算
+    // 根据欧拉角计算前向向量
+    Forward.x = cos(Pitch) * sin(Yaw);
+    Forward.y = sin(Pitch);
+    Forward.z = cos(Pitch) * cos(Yaw);
+    // 计算右向和上向向量（基于世界上方向）
+    Right = normalize(cross(Forward, WorldUp)); // 右向 = 前向 × 世界上向
+    Up = normalize(cross(Forward, Right));      // 上向 = 前向 × 右向（确保正交）
+}
+
+// 构造函数（初始化变换参数并计算初始方向）
+Transform::Transform(vec3 pos, vec3 rotation, vec3 scale) 
+    : position(pos), rotation(rotation), scale(scale) {
+    name += "Transform"; // 设置组件名称
+    // 初始方向计算（与RealUpdate逻辑一致）
+    Forward.x = cos(Pitch) * sin(Yaw);
+    Forward.y = sin(Pitch);
+    Forward.z = cos(Pitch) * cos(Yaw);
+    Right = normalize(cross(Forward, WorldUp));
+    Up = normalize(cross(Right, Forward));
+    TransformBatch::Register(this); // 加入批量更新的SoA镜像
+}
+
+// 析构函数（移出批量更新）
+Transform::~Transform() {
+    TransformBatch::Unregister(this);
+}
+
+#pragma endregion
+
+
+// ====================== Headless 无窗口渲染 ======================
+#pragma region Headless
+
+// 无窗口模式（服务器生成缩略图和序列帧）：EGL无表面上下文或OSMesa，场景画到离屏FBO，
+// 每帧用PBO异步读回，几帧之后再映射（不在glReadPixels处等待GPU），由后台线程编码写盘
+//
+// 主循环用法：InitSettings之后调用 Headless::Init 代替创建GLFW窗口（window保持为nullptr），
+// 每帧在RealUpdate之前调用 BeginFrame，在所有RealUpdate之后调用 EndFrame，退出前调用 Shutdown
+// （场景由主相机的RealUpdate通过 RenderPipeline::BeginFrame 绘制，EndFrame读回的是这一次绘制的结果）
+class Headless {
+public:
+    static bool enabled;
+    static GLuint framebuffer;          // 场景的目标帧缓冲（窗口模式为0，无窗口模式为离屏FBO）
+    static const int ringSize = 3;      // PBO环大小：读回在ringSize帧之后才映射
+    static const int maxQueued = 8;     // 编码队列上限（写盘跟不上时主线程等待，内存有上界）
+    static bool Init(const string& outputDir, bool png = true);
+    static void BeginFrame();           // 绑定离屏FBO并清屏
+    static void EndFrame();             // 发起本帧读回，收取ringSize帧前的读回
+    static void Shutdown();             // 收取剩余读回，等待编码线程写完
+    static int captured, written;
+private:
+    struct Readback {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        int frame = -1;
+    };
+    struct Encoded {
+        int frame;
+        std::vector<unsigned char> pixels;
+    };
+    static bool CreateContext();
+    static void Collect(Readback& slot);
+    static void EncoderLoop();
+    static GLuint color, depth;
+    static int width, height, frameIndex;
+    static Readback ring[ringSize];
+    static string outputDir;
+    static bool png;
+    static std::thread encoder;
+    static std::mutex mutex;
+    static std::condition_variable wake, drained;
+    static std::deque<Encoded> queue;
+    static std::vector<std::vector<unsigned char>> freeBuffers; // 复用像素缓冲，稳定后不再分配
+    static bool stopping;
+};
+
+// 静态成员初始化
+bool Headless::enabled = false;
+GLuint Headless::framebuffer = 0;
+int Headless::captured = 0;
+int Headless::written = 0;
+GLuint Headless::color = 0;
+GLuint Headless::depth = 0;
+int Headless::width = 0;
+int Headless::height = 0;
+int Headless::frameIndex = 0;
+Headless::Readback Headless::ring[Headless::ringSize];
+string Headless::outputDir;
+bool Headless::png = true;
+std::thread Headless::encoder;
+std::mutex Headless::mutex;
+std::condition_variable Headless::wake;
+std::condition_variable Headless::drained;
+std::deque<Headless::Encoded> Headless::queue;
+std::vector<std::vector<unsigned char>> Headless::freeBuffers;
+bool Headless::stopping = false;
+
+// 创建无窗口的OpenGL上下文（编译时用HEADLESS_EGL或HEADLESS_OSMESA选择后端）
+bool Headless::CreateContext() {
+#if defined(HEADLESS_EGL)
+    // 优先用Mesa的surfaceless平台，不需要任何显示服务器
+    EGLDisplay display = EGL_NO_DISPLAY;
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cout << "Headless: eglInitialize failed" << std::endl;
+        return false;
+    }
+    const EGLint configAttribs[] = { EGL_SURFACE_TYPE, EGL_DONT_CARE, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config;
+    EGLint configCount = 0;
+    eglBindAPI(EGL_OPENGL_API);
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+        std::cout << "Headless: no EGL config with desktop OpenGL" << std::endl;
+        return false;
+    }
+    const EGLint contextAttribs[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    // EGL_KHR_surfaceless_context：不创建任何表面，所有绘制都进FBO
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cout << "Headless: eglCreateContext/eglMakeCurrent failed" << std::endl;
+        return false;
+    }
+    return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+#elif defined(HEADLESS_OSMESA)
+    // 纯软件渲染；OSMesa要求一块颜色缓冲才能MakeCurrent，实际绘制仍然进FBO
+    const int attribs[] = { OSMESA_FORMAT, OSMESA_RGBA, OSMESA_DEPTH_BITS, 24, OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, 3, OSMESA_CONTEXT_MINOR_VERSION, 3, 0 };
+    OSMesaContext context = OSMesaCreateContextAttribs(attribs, nullptr);
+    static std::vector<unsigned char> backBuffer;
+    backBuffer.resize((size_t)width * height * 4);
+    if (!context || !OSMesaMakeCurrent(context, backBuffer.data(), GL_UNSIGNED_BYTE, width, height)) {
+        std::cout << "Headless: OSMesa context creation failed" << std::endl;
+        return false;
+    }
+    return gladLoadGLLoader((GLADloadproc)OSMesaGetProcAddress) != 0;
+#else
+    std::cout << "Headless: built without HEADLESS_EGL or HEADLESS_OSMESA" << std::endl;
+    return false;
+#endif
+}
+
+bool Headless::Init(const string & dir, bool writePng) {
+    width = (int)Setting::windowSize.x;
+    height = (int)Setting::windowSize.y;
+    if (!CreateContext()) return false;
+    enabled = true;
+    outputDir = dir;
+#if defined(HEADLESS_PNG)
+    png = writePng;
+#else
+    png = false; // 没有stb_image_write时只输出原始RGBA
+#endif
+
+    // 离屏FBO（大小取Setting::windowSize）
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Headless: offscreen framebuffer incomplete" << std::endl;
+
+    // PBO环（GL_STREAM_READ：驱动把它放在适合CPU读取的内存里）
+    for (auto& slot : ring) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    stopping = false;
+    encoder = std::thread(EncoderLoop);
+    return true;
+}
+
+void Headless::BeginFrame() {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// 发起本帧读回；复用的PBO是ringSize帧之前写入的，通常早已完成，映射时不会等待
+void Headless::EndFrame() {
+    if (!enabled) return;
+    Readback& slot = ring[frameIndex % ringSize];
+    if (slot.fence) Collect(slot);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr); // 写入PBO，立即返回
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frameIndex++;
+}
+
+// 映射已完成的PBO，拷贝到编码队列
+void Headless::Collect(Readback & slot) {
+    while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    size_t bytes = (size_t)width * height * 4;
+    std::vector<unsigned char> pixels;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [] { return (int)queue.size() < maxQueued; });
+        if (!freeBuffers.empty()) {
+            pixels = std::move(freeBuffers.back());
+            freeBuffers.pop_back();
+        }
+    }
+    pixels.resize(bytes);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (mapped) {
+        memcpy(pixels.data(), mapped, bytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    captured++;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(Encoded{ slot.frame, std::move(pixels) });
+    }
+    wake.notify_one();
+}
+
+// 编码线程：PNG（需要stb_image_write）或原始RGBA，行序翻转为自上而下
+void Headless::EncoderLoop() {
+    std::vector<unsigned char> flipped;
+    for (;;) {
+        Encoded item;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [] { return stopping || !queue.empty(); });
+            if (queue.empty()) return; // stopping且已写完
+            item = std::move(queue.front());
+            queue.pop_front();
+        }
+        drained.notify_one();
+
+        char name[64];
+        size_t stride = (size_t)width * 4;
+        if (png) {
+#if defined(HEADLESS_PNG)
+            snprintf(name, sizeof(name), "/frame_%05d.png", item.frame);
+            // 从最后一行开始、负步长写出，不需要额外翻转
+            stbi_write_png((outputDir + name).c_str(), width, height, 4,
+                item.pixels.data() + stride * (height - 1), -(int)stride);
+#endif
+        } else {
+            snprintf(name, sizeof(name), "/frame_%05d_%dx%d.rgba", item.frame, width, height);
+            flipped.resize(item.pixels.size());
+            for (int y = 0; y < height; y++)
+                memcpy(flipped.data() + stride * y, item.pixels.data() + stride * (height - 1 - y), stride);
+            std::ofstream file(outputDir + name, std::ios::binary);
+            file.write((const char*)flipped.data(), flipped.size());
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        written++;
+        freeBuffers.push_back(std::move(item.pixels));
+    }
+}
+
+void Headless::Shutdown() {
+    if (!enabled) return;
+    // 按帧顺序收取还在环里的读回
+    for (int i = 0; i < ringSize; i++) {
+        Readback& slot = ring[(frameIndex + i) % ringSize];
+        if (slot.fence) Collect(slot);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (encoder.joinable()) encoder.join();
+    std::cout << "Headless: " << written << " frames written to " << outputDir << std::endl;
+
+    for (auto& slot : ring) glDeleteBuffers(1, &slot.pbo);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &color);
+    glDeleteRenderbuffers(1, &depth);
+    framebuffer = 0;
+    enabled = false;
+}
+
+#pragma endregion
+
+
+// ====================== TextureStreamer 压缩纹理流式加载 ======================
+#pragma region TextureStreamer
+
+// 块压缩格式（KTX2中的vkFormat）
+enum class BlockFormat { BC1 = 133, BC3 = 137, BC5 = 141, BC7 = 145 };
+
+// 块压缩编解码与KTX2转换（离线工具，同时提供驱动不支持时的CPU解码）
+class TextureCompressor {
+public:
+    // 转换普通图片为KTX2（生成完整mip链并压缩；BC7编码不在此实现）
+    static bool Convert(const string& src, const string& dst, BlockFormat format);
+    // 转换天空盒六个面为KTX2立方体贴图
+    static bool ConvertCubemap(const vector<string>& faces, const string& directory, const string& dst, BlockFormat format);
+    static int BlockBytes(BlockFormat format) { return format == BlockFormat::BC1 ? 8 : 16; }
+    static size_t LevelBytes(BlockFormat format, int width, int height) {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+    }
+    static bool CanDecode(BlockFormat format) { return format != BlockFormat::BC7; }
+    // CPU解码一层到RGBA8
+    static void Decode(BlockFormat format, const unsigned char* blocks, int width, int height, unsigned char* rgba);
+private:
+    static void EncodeLevel(BlockFormat format, const unsigned char* rgba, int width, int height, std::vector<unsigned char>& out);
+    static void EncodeColorBlock(const unsigned char block[64], unsigned char out[8]);
+    static void EncodeAlphaBlock(const unsigned char values[16], unsigned char out[8]);
+    static void DecodeColorBlock(const unsigned char* in, unsigned char block[64], bool allowTransparent);
+    static void DecodeAlphaBlock(const unsigned char* in, unsigned char values[16]);
+    static void Downsample(const std::vector<unsigned char>& src, int width, int height, std::vector<unsigned char>& dst);
+    static bool WriteKtx2(const string& dst, BlockFormat format, int width, int height, int faces,
+        const std::vector<std::vector<unsigned char>>& levels);
+};
+
+// RGB888 <-> RGB565
+static unsigned short PackRGB565(const unsigned char* c) {
+    return (unsigned short)(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+static void UnpackRGB565(unsigned short v, unsigned char* c) {
+    c[0] = (unsigned char)(((v >> 11) & 31) * 255 / 31);
+    c[1] = (unsigned char)(((v >> 5) & 63) * 255 / 63);
+    c[2] = (unsigned char)((v & 31) * 255 / 31);
+}
+
+// 浮点颜色量化为RGB565（四舍五入）
+static unsigned short QuantizeRGB565(const float* c) {
+    int r = std::min(31, std::max(0, (int)(c[0] * 31.0f / 255.0f + 0.5f)));
+    int g = std::min(63, std::max(0, (int)(c[1] * 63.0f / 255.0f + 0.5f)));
+    int b = std::min(31, std::max(0, (int)(c[2] * 31.0f / 255.0f + 0.5f)));
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+// 按端点（c0 >= c1）生成四色调色板，为每个像素选最近的颜色，返回平方误差和
+static int MatchColorIndices(const unsigned char block[64], unsigned short c0, unsigned short c1, unsigned int& indices) {
+    unsigned char palette[4][3];
+    UnpackRGB565(c0, palette[0]);
+    UnpackRGB565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (unsigned char)((2 * palette[0][c] + palette[1][c]) / 3);
+        palette[3][c] = (unsigned char)((palette[0][c] + 2 * palette[1][c]) / 3);
+    }
+    int colors = c0 == c1 ? 1 : 4; // 端点相同时所有索引为0（否则会进入三色模式）
+    int total = 0;
+    indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 0, bestDist = INT_MAX;
+        for (int p = 0; p < colors; p++) {
+            int dist = 0;
+            for (int c = 0; c < 3; c++) {
+                int d = block[i * 4 + c] - palette[p][c];
+                dist += d * d;
+            }
+            if (dist < bestDist) { bestDist = dist; best = p; }
+        }
+        indices |= (unsigned int)best << (2 * i);
+        total += bestDist;
+    }
+    return total;
+}
+
+// 颜色块（BC1四色模式）：端点取颜色主轴（协方差矩阵幂迭代）上投影的两端，和包围盒对角比较误差，
+// 再按选定的索引用最小二乘求最优端点，误差变小才采用
+void TextureCompressor::EncodeColorBlock(const unsigned char block[64], unsigned char out[8]) {
+    float mean[3] = { 0, 0, 0 };
+    unsigned char lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++) {
+            mean[c] += block[i * 4 + c] / 16.0f;
+            lo[c] = std::min(lo[c], block[i * 4 + c]);
+            hi[c] = std::max(hi[c], block[i * 4 + c]);
+        }
+    float cov[6] = { 0 }; // xx xy xz yy yz zz
+    for (int i = 0; i < 16; i++) {
+        float d[3] = { block[i * 4] - mean[0], block[i * 4 + 1] - mean[1], block[i * 4 + 2] - mean[2] };
+        cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+    }
+    float axis[3] = { (float)(hi[0] - lo[0]), (float)(hi[1] - lo[1]), (float)(hi[2] - lo[2]) };
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+        float length = std::max(std::abs(next[0]), std::max(std::abs(next[1]), std::abs(next[2])));
+        if (length < 1e-6f) break; // 纯色块，保留初值
+        for (int c = 0; c < 3; c++) axis[c] = next[c] / length;
+    }
+    float tMin = FLT_MAX, tMax = -FLT_MAX, axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    for (int i = 0; i < 16 && axisLength > 0; i++) {
+        float t = ((block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2]) / axisLength;
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    if (axisLength <= 0) tMin = tMax = 0;
+    float e0[3], e1[3];
+    for (int c = 0; c < 3; c++) {
+        e0[c] = mean[c] + axis[c] * tMax;
+        e1[c] = mean[c] + axis[c] * tMin;
+    }
+
+    // 候选端点：主轴两端、包围盒对角
+    unsigned short c0 = QuantizeRGB565(e0), c1 = QuantizeRGB565(e1);
+    if (c0 < c1) std::swap(c0, c1);
+    unsigned int indices;
+    int error = MatchColorIndices(block, c0, c1, indices);
+    unsigned short b0 = PackRGB565(hi), b1 = PackRGB565(lo);
+    if (b0 < b1) std::swap(b0, b1);
+    unsigned int boxIndices;
+    int boxError = MatchColorIndices(block, b0, b1, boxIndices);
+    if (boxError < error) { c0 = b0; c1 = b1; indices = boxIndices; error = boxError; }
+
+    // 最小二乘：每个像素是 w0*e0 + w1*e1（索引0/1/2/3对应权重1、0、2/3、1/3）
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    for (int iteration = 0; iteration < 2 && error > 0 && c0 != c1; iteration++) {
+        float aa = 0, ab = 0, bb = 0, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; i++) {
+            float w0 = weights[(indices >> (2 * i)) & 3], w1 = 1.0f - w0;
+            aa += w0 * w0; ab += w0 * w1; bb += w1 * w1;
+            for (int c = 0; c < 3; c++) {
+                ax[c] += w0 * block[i * 4 + c];
+                bx[c] += w1 * block[i * 4 + c];
+            }
+        }
+        float det = aa * bb - ab * ab;
+        if (std::abs(det) < 1e-6f) break; // 所有像素落在同一个端点上
+        for (int c = 0; c < 3; c++) {
+            e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+            e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+        }
+        unsigned short r0 = QuantizeRGB565(e0), r1 = QuantizeRGB565(e1);
+        if (r0 < r1) std::swap(r0, r1);
+        unsigned int refinedIndices;
+        int refinedError = MatchColorIndices(block, r0, r1, refinedIndices);
+        if (refinedError >= error) break;
+        c0 = r0; c1 = r1; indices = refinedIndices; error = refinedError;
+    }
+
+    out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++) out[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+// 单通道块（BC4，即BC3的alpha和BC5的每个通道）：八值模式
+void TextureCompressor::EncodeAlphaBlock(const unsigned char values[16], unsigned char out[8]) {
+    unsigned char a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, values[i]);
+        a1 = std::min(a1, values[i]);
+    }
+    unsigned long long indices = 0;
+    if (a0 != a1) {
+        int palette[8] = { a0, a1 };
+        for (int p = 1; p < 7; p++) palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDist = INT_MAX;
+            for (int p = 0; p < 8; p++) {
+                int dist = std::abs(values[i] - palette[p]);
+                if (dist < bestDist) { bestDist = dist; best = p; }
+            }
+            indices |= (unsigned long long)best << (3 * i);
+        }
+    }
+    out[0] = a0;
+    out[1] = a1;
+    for (int i = 0; i < 6; i++) out[2 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+// 编码一层（边缘不足4像素的块重复边缘像素）
+void TextureCompressor::EncodeLevel(BlockFormat format, const unsigned char * rgba, int width, int height, std::vector<unsigned char>& out) {
+    out.resize(LevelBytes(format, width, height));
+    unsigned char* dst = out.data();
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            unsigned char block[64];
+            for (int y = 0; y < 4; y++)
+                for (int x = 0; x < 4; x++)
+                    memcpy(block + (y * 4 + x) * 4, rgba + (std::min(by + y, height - 1) * width + std::min(bx + x, width - 1)) * 4, 4);
+            unsigned char channel[16];
+            switch (format) {
+            case BlockFormat::BC1:
+                EncodeColorBlock(block, dst);
+                dst += 8;
+                break;
+            case BlockFormat::BC3:
+                for (int i = 0; i < 16; i++) channel[i] = block[i * 4 + 3];
+                EncodeAlphaBlock(channel, dst);
+                EncodeColorBlock(block, dst + 8);
+                dst += 16;
+                break;
+            default: // BC5（法线贴图的RG通道）
+                for (int c = 0; c < 2; c++) {
+                    for (int i = 0; i < 16; i++) channel[i] = block[i * 4 + c];
+                    EncodeAlphaBlock(channel, dst + c * 8);
+                }
+                dst += 16;
+                break;
+            }
+        }
+    }
+}
+
+// 解码颜色块（allowTransparent时支持BC1的三色+透明模式）
+void TextureCompressor::DecodeColorBlock(const unsigned char * in, unsigned char block[64], bool allowTransparent) {
+    unsigned short c0 = in[0] | (in[1] << 8), c1 = in[2] | (in[3] << 8);
+    unsigned char palette[4][4];
+    UnpackRGB565(c0, palette[0]);
+    UnpackRGB565(c1, palette[1]);
+    palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+    for (int c = 0; c < 3; c++) {
+        if (c0 > c1 || !allowTransparent) {
+            palette[2][c] = (unsigned char)((2 * palette[0][c] + palette[1][c]) / 3);
+            palette[3][c] = (unsigned char)((palette[0][c] + 2 * palette[1][c]) / 3);
+        } else {
+            palette[2][c] = (unsigned char)((palette[0][c] + palette[1][c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+    if (c0 <= c1 && allowTransparent) palette[3][3] = 0;
+    unsigned int indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((unsigned int)in[7] << 24);
+    for (int i = 0; i < 16; i++)
+        memcpy(block + i * 4, palette[(indices >> (2 * i)) & 3], 4);
+}
+
+// 解码单通道块
+void TextureCompressor::DecodeAlphaBlock(const unsigned char * in, unsigned char values[16]) {
+    int a0 = in[0], a1 = in[1];
+    int palette[8] = { a0, a1 };
+    if (a0 > a1) {
+        for (int p = 1; p < 7; p++) palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+    } else { // 六值模式 + 0 + 255
+        for (int p = 1; p < 5; p++) palette[p + 1] = ((5 - p) * a0 + p * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    unsigned long long indices = 0;
+    for (int i = 0; i < 6; i++) indices |= (unsigned long long)in[2 + i] << (8 * i);
+    for (int i = 0; i < 16; i++)
+        values[i] = (unsigned char)palette[(indices >> (3 * i)) & 7];
+}
+
+void TextureCompressor::Decode(BlockFormat format, const unsigned char * blocks, int width, int height, unsigned char * rgba) {
+    int step = BlockBytes(format);
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4, blocks += step) {
+            unsigned char block[64], channel[16];
+            switch (format) {
+            case BlockFormat::BC1:
+                DecodeColorBlock(blocks, block, true);
+                break;
+            case BlockFormat::BC3:
+                DecodeColorBlock(blocks + 8, block, false);
+                DecodeAlphaBlock(blocks, channel);
+                for (int i = 0; i < 16; i++) block[i * 4 + 3] = channel[i];
+                break;
+            default: // BC5
+                for (int c = 0; c < 2; c++) {
+                    DecodeAlphaBlock(blocks + c * 8, channel);
+                    for (int i = 0; i < 16; i++) block[i * 4 + c] = channel[i];
+                }
+                for (int i = 0; i < 16; i++) { block[i * 4 + 2] = 0; block[i * 4 + 3] = 255; }
+                break;
+            }
+            for (int y = 0; y < 4 && by + y < height; y++)
+                for (int x = 0; x < 4 && bx + x < width; x++)
+                    memcpy(rgba + ((by + y) * width + bx + x) * 4, block + (y * 4 + x) * 4, 4);
+        }
+    }
+}
+
+// 2x2盒式滤波生成下一级mip（奇数尺寸时边缘像素重复）
+void TextureCompressor::Downsample(const std::vector<unsigned char>& src, int width, int height, std::vector<unsigned char>& dst) {
+    int w = std::max(1, width / 2), h = std::max(1, height / 2);
+    dst.resize((size_t)w * h * 4);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            for (int c = 0; c < 4; c++) {
+                int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+                int sum = src[(y0 * width + x0) * 4 + c] + src[(y0 * width + x1) * 4 + c]
+                    + src[(y1 * width + x0) * 4 + c] + src[(y1 * width + x1) * 4 + c];
+                dst[(y * w + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+}
+
+// 写KTX2文件（levels[i]为第i层所有面的数据；只写最简数据格式描述符）
+bool TextureCompressor::WriteKtx2(const string & dst, BlockFormat format, int width, int height, int faces,
+    const std::vector<std::vector<unsigned char>>& levels) {
+    std::ofstream file(dst, std::ios::binary);
+    if (!file) return false;
+    auto u32 = [&](unsigned int v) { file.write((const char*)&v, 4); };
+    auto u64 = [&](unsigned long long v) { file.write((const char*)&v, 8); };
+    static const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    const unsigned int levelCount = (unsigned int)levels.size();
+    const unsigned int dfdOffset = 80 + 24 * levelCount, dfdLength = 44;
+    file.write((const char*)identifier, 12);
+    u32((unsigned int)format); u32(1); u32(width); u32(height); u32(0); u32(0); u32(faces); u32(levelCount); u32(0);
+    u32(dfdOffset); u32(dfdLength); u32(0); u32(0); u64(0); u64(0);
+
+    // 数据从小到大排列（规范推荐，流式加载时先读到的就是小mip）
+    std::vector<unsigned long long> offsets(levelCount);
+    unsigned long long offset = dfdOffset + dfdLength;
+    for (int i = (int)levelCount - 1; i >= 0; i--) {
+        offset = (offset + 15) & ~15ull; // 对齐到块大小
+        offsets[i] = offset;
+        offset += levels[i].size();
+    }
+    for (unsigned int i = 0; i < levelCount; i++) {
+        u64(offsets[i]); u64(levels[i].size()); u64(levels[i].size());
+    }
+
+    // 基础数据格式描述块（单采样）
+    unsigned char colorModel = format == BlockFormat::BC1 ? 128 : format == BlockFormat::BC3 ? 130 : format == BlockFormat::BC5 ? 132 : 134;
+    u32(dfdLength); u32(0); u32(2 | (40u << 16));
+    unsigned char model[4] = { colorModel, 1, 1, 0 }, dims[4] = { 3, 3, 0, 0 }, planes[8] = { (unsigned char)BlockBytes(format) };
+    file.write((const char*)model, 4); file.write((const char*)dims, 4); file.write((const char*)planes, 8);
+    u32((unsigned int)(BlockBytes(format) * 8 - 1) << 16); u32(0); u32(0); u32(0xFFFFFFFF);
+
+    for (int i = (int)levelCount - 1; i >= 0; i--) {
+        while ((unsigned long long)file.tellp() < offsets[i]) file.put(0);
+        file.write((const char*)levels[i].data(), levels[i].size());
+    }
+    return (bool)file;
+}
+
+bool TextureCompressor::Convert(const string & src, const string & dst, BlockFormat format) {
+    return ConvertCubemap({ src }, "", dst, format);
+}
+
+// 转换一张或六张图片（每张都生成完整mip链，同一层的各个面连续存放）
+bool TextureCompressor::ConvertCubemap(const vector<string>& faces, const string & directory, const string & dst, BlockFormat format) {
+    if (format == BlockFormat::BC7) {
+        std::cout << "TextureCompressor: BC7 encoding is not supported" << std::endl;
+        return false;
+    }
+    std::vector<std::vector<unsigned char>> levels;
+    int width = 0, height = 0;
+    for (size_t f = 0; f < faces.size(); f++) {
+        int w, h, channels;
+        string path = directory.empty() ? faces[f] : directory + '\\' + faces[f];
+        VfsFile source;
+        unsigned char* data = Vfs::Read(path, source)
+            ? stbi_load_from_memory(source.data, (int)source.size, &w, &h, &channels, 4) : nullptr;
+        if (!data) {
+            std::cout << "TextureCompressor: failed to load " << path << std::endl;
+            return false;
+        }
+        if (f == 0) { width = w; height = h; }
+        std::vector<unsigned char> image(data, data + (size_t)w * h * 4), next, blocks;
+        stbi_image_free(data);
+        for (int level = 0; ; level++) {
+            EncodeLevel(format, image.data(), w, h, blocks);
+            if ((int)levels.size() <= level) levels.emplace_back();
+            levels[level].insert(levels[level].end(), blocks.begin(), blocks.end());
+            if (w == 1 && h == 1) break;
+            Downsample(image, w, h, next);
+            image.swap(next);
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+    }
+    return WriteKtx2(dst, format, width, height, (int)faces.size(), levels);
+}
+
+// 流式纹理（小mip先上传，大mip在后续帧按预算补齐）
+struct StreamedTexture {
+    GLuint id = 0;
+    GLenum target = GL_TEXTURE_2D;
+    string path;
+    BlockFormat format = BlockFormat::BC1;
+    int width = 0, height = 0, faces = 1;
+    bool cpuDecode = false;               // 驱动不支持该格式，CPU解码后以RGBA8上传
+    std::vector<std::pair<unsigned long long, unsigned long long>> levels; // 每层（文件偏移，字节数）
+    int baseLevel = 0;                    // 当前已上传的最大mip层
+    int refs = 1;                         // 同一文件的加载共享一个纹理
+    size_t residentBytes = 0;             // 已上传层占用的显存
+};
+
+// 流式纹理加载
+class TextureStreamer {
+public:
+    static size_t frameBudget;       // 每帧上传的字节预算
+    static int residentMinSize;      // 加载时同步上传不超过该尺寸的mip
+    static GLuint Load(const string& path);  // 加载KTX2（返回的纹理立即可用；同一文件增加一次引用）
+    static bool Release(GLuint id);          // 引用归零时删除纹理；不是流式纹理返回false
+    static string Resolve(const string& file, const string& directory); // 有同名.ktx2时返回其路径
+    static void Update();            // 每帧调用，在预算内上传更大的mip
+    static void OnGUI();
+    static size_t uploadedThisFrame, pendingBytes, residentBytes;
+private:
+    static bool Supported(BlockFormat format);
+    static void UploadLevel(StreamedTexture& texture, int level);
+    static std::vector<StreamedTexture> textures;
+};
+
+// 静态成员初始化
+size_t TextureStreamer::frameBudget = 4 * 1024 * 1024;
+int TextureStreamer::residentMinSize = 64;
+size_t TextureStreamer::uploadedThisFrame = 0;
+size_t TextureStreamer::pendingBytes = 0;
+size_t TextureStreamer::residentBytes = 0;
+std::vector<StreamedTexture> TextureStreamer::textures;
+
+static GLenum BlockFormatToGL(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1: return 0x83F1; // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+    case BlockFormat::BC3: return 0x83F3; // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+    default: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+}
+
+// 驱动是否支持该压缩格式
+bool TextureStreamer::Supported(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1:
+    case BlockFormat::BC3: return GLAD_GL_EXT_texture_compression_s3tc;
+    case BlockFormat::BC5: return true; // RGTC是OpenGL 3.0核心功能
+    default: return GLAD_GL_ARB_texture_compression_bptc;
+    }
+}
+
+// 有同名.ktx2文件时优先使用
+string TextureStreamer::Resolve(const string & file, const string & directory) {
+    string path = directory.empty() ? file : directory + '\\' + file;
+    string ktx = path.substr(0, path.find_last_of('.')) + ".ktx2";
+    return Vfs::Exists(ktx) ? ktx : string();
+}
+
+// 上传一层（所有面）
+void TextureStreamer::UploadLevel(StreamedTexture & texture, int level) {
+    int w = std::max(1, texture.width >> level), h = std::max(1, texture.height >> level);
+    size_t bytes = (size_t)texture.levels[level].second, offset = (size_t)texture.levels[level].first;
+    // 档案中未压缩的KTX2直接从映射上传，否则读到帧分配器中
+    const unsigned char* data = Vfs::Direct(texture.path, offset, bytes);
+    if (!data) {
+        unsigned char* buffer = FrameArena::Allocate<unsigned char>(bytes);
+        if (!Vfs::ReadRange(texture.path, offset, bytes, buffer)) memset(buffer, 0, bytes);
+        data = buffer;
+    }
+    size_t faceBytes = bytes / texture.faces;
+    unsigned char* rgba = texture.cpuDecode ? FrameArena::Allocate<unsigned char>((size_t)w * h * 4) : nullptr;
+    glBindTexture(texture.target, texture.id);
+    for (int f = 0; f < texture.faces; f++) {
+        GLenum face = texture.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + f : GL_TEXTURE_2D;
+        const unsigned char* blocks = data + faceBytes * f;
+        if (texture.cpuDecode) {
+            TextureCompressor::Decode(texture.format, blocks, w, h, rgba);
+            glTexImage2D(face, level, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+        } else {
+            glCompressedTexImage2D(face, level, BlockFormatToGL(texture.format), w, h, 0, (GLsizei)faceBytes, blocks);
+        }
+    }
+    texture.baseLevel = level;
+    glTexParameteri(texture.target, GL_TEXTURE_BASE_LEVEL, level); // 只采样已上传的层
+    uploadedThisFrame += bytes;
+    size_t resident = texture.cpuDecode ? (size_t)w * h * 4 * texture.faces : bytes;
+    texture.residentBytes += resident;
+    residentBytes += resident;
+}
+
+// 加载KTX2：读头部和层索引，同步上传小mip，其余层排队
+GLuint TextureStreamer::Load(const string & path) {
+    for (auto& loaded : textures)
+        if (loaded.path == path) {
+            loaded.refs++;
+            return loaded.id;
+        }
+    unsigned char prefix[12 + 13 * 4 + 2 * 8];
+    unsigned char identifier[12];
+    unsigned int header[13];
+    bool good = Vfs::ReadRange(path, 0, sizeof(prefix), prefix);
+    memcpy(identifier, prefix, 12);
+    memcpy(header, prefix + 12, sizeof(header));
+    if (!good || identifier[1] != 'K' || identifier[5] != '2') {
+        std::cout << "TextureStreamer: not a KTX2 file " << path << std::endl;
+        return 0;
+    }
+    if (header[8] != 0) { // 不处理超压缩（Basis/Zstd）
+        std::cout << "TextureStreamer: supercompressed KTX2 is not supported " << path << std::endl;
+        return 0;
+    }
+    // 头部字段在转换成int、计算层大小之前先检查范围，损坏的文件直接拒绝
+    BlockFormat format = (BlockFormat)header[0];
+    bool knownFormat = format == BlockFormat::BC1 || format == BlockFormat::BC3 || format == BlockFormat::BC5 || format == BlockFormat::BC7;
+    const unsigned int maxSize = 1u << 16;
+    if (!knownFormat || header[2] == 0 || header[3] == 0 || header[2] > maxSize || header[3] > maxSize ||
+        (header[6] != 1 && header[6] != 6)) {
+        std::cout << "TextureStreamer: invalid KTX2 header " << path << std::endl;
+        return 0;
+    }
+    StreamedTexture texture;
+    texture.path = path;
+    texture.format = format;
+    texture.width = (int)header[2];
+    texture.height = (int)header[3];
+    texture.faces = (int)header[6];
+    int maxLevels = 1;
+    while ((std::max(texture.width, texture.height) >> maxLevels) > 0) maxLevels++; // log2(max(w,h)) + 1
+    if (header[7] > (unsigned int)maxLevels) {
+        std::cout << "TextureStreamer: invalid level count in " << path << std::endl;
+        return 0;
+    }
+    int levelCount = std::max(1, (int)header[7]);
+    std::vector<unsigned long long> levelIndex((size_t)levelCount * 3);
+    if (!Vfs::ReadRange(path, sizeof(prefix), levelIndex.size() * sizeof(unsigned long long), levelIndex.data())) {
+        std::cout << "TextureStreamer: truncated KTX2 file " << path << std::endl;
+        return 0;
+    }
+    // 每层必须完整落在文件内，且大小与格式、尺寸、面数一致（上传时按此切分各面）
+    unsigned long long fileSize = Vfs::Size(path);
+    for (int i = 0; i < levelCount; i++) {
+        unsigned long long offset = levelIndex[i * 3], bytes = levelIndex[i * 3 + 1];
+        int w = std::max(1, texture.width >> i), h = std::max(1, texture.height >> i);
+        unsigned long long expected = (unsigned long long)texture.faces * TextureCompressor::LevelBytes(format, w, h);
+        if (bytes != expected || offset < sizeof(prefix) || offset > fileSize || bytes > fileSize - offset) {
+            std::cout << "TextureStreamer: level " << i << " out of range in " << path << std::endl;
+            return 0;
+        }
+        texture.levels.push_back(std::make_pair(offset, bytes));
+    }
+    if (!Supported(texture.format)) {
+        if (!TextureCompressor::CanDecode(texture.format)) {
+            std::cout << "TextureStreamer: unsupported format in " << path << std::endl;
+            return 0;
+        }
+        texture.cpuDecode = true;
+    }
+    texture.target = texture.faces == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+
+    glGenTextures(1, &texture.id);
+    glBindTexture(texture.target, texture.id);
+    glTexParameteri(texture.target, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    glTexParameteri(texture.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(texture.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GLint wrap = texture.target == GL_TEXTURE_CUBE_MAP ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    glTexParameteri(texture.target, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(texture.target, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(texture.target, GL_TEXTURE_WRAP_R, wrap);
+
+    // 从最小的mip开始同步上传，保证纹理立即可以绘制
+    texture.baseLevel = levelCount;
+    for (int level = levelCount - 1; level >= 0; level--) {
+        bool small = std::max(texture.width >> level, texture.height >> level) <= residentMinSize;
+        if (!small && level != levelCount - 1) break;
+        UploadLevel(texture, level);
+    }
+    glBindTexture(texture.target, 0);
+    textures.push_back(texture);
+    return texture.id;
+}
+
+bool TextureStreamer::Release(GLuint id) {
+    for (size_t i = 0; i < textures.size(); i++) {
+        if (textures[i].id != id) continue;
+        if (--textures[i].refs > 0) return true;
+        residentBytes -= textures[i].residentBytes;
+        glDeleteTextures(1, &textures[i].id);
+        textures.erase(textures.begin() + i);
+        return true;
+    }
+    return false;
+}
+
+// 每帧在预算内上传：总是先上传所有纹理中最小的待上传层
+void TextureStreamer::Update() {
+    uploadedThisFrame = 0;
+    pendingBytes = 0;
+    for (;;) {
+        StreamedTexture* next = nullptr;
+        for (auto& texture : textures) {
+            if (texture.baseLevel == 0) continue;
+            if (!next || texture.levels[texture.baseLevel - 1].second < next->levels[next->baseLevel - 1].second)
+                next = &texture;
+        }
+        if (!next) break;
+        size_t bytes = (size_t)next->levels[next->baseLevel - 1].second;
+        // 超出预算就留到下一帧（本帧还没上传过时至少上传一层，避免大层永远等不到）
+        if (uploadedThisFrame > 0 && uploadedThisFrame + bytes > frameBudget) break;
+        UploadLevel(*next, next->baseLevel - 1);
+    }
+    for (auto& texture : textures)
+        for (int level = 0; level < texture.baseLevel; level++)
+            pendingBytes += (size_t)texture.levels[level].second;
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// ImGui 调试界面（显示流式上传进度）
+void TextureStreamer::OnGUI() {
+    if (ImGui::TreeNode("TextureStreamer")) {
+        int budgetKB = (int)(frameBudget / 1024);
+        if (ImGui::DragInt("BudgetKB", &budgetKB, 64, 64, 65536)) frameBudget = (size_t)budgetKB * 1024;
+        ImGui::Text("textures: %d  uploaded: %.1f KB  pending: %.1f MB  resident: %.1f MB", (int)textures.size(),
+            uploadedThisFrame / 1024.0f, pendingBytes / (1024.0f * 1024.0f), residentBytes / (1024.0f * 1024.0f));
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+#pragma endregion
+
+
+// ====================== TextureArrays 纹理数组 ======================
+#pragma region TextureArrays
+
+// 纹理数组（尺寸和格式相同的材质纹理打包进一个GL_TEXTURE_2D_ARRAY）
+struct TextureArray {
+    GLuint id = 0;                 // OpenGL纹理对象（Build之前为0）
+    int width = 0, height = 0;     // 每层尺寸
+    int channels = 0;              // 通道数
+    int capacity = 0;              // 已分配的层数（显存按容量分配）
+    GLenum format = GL_RGBA;       // 像素格式
+    std::vector<string> layers;    // 每层对应的纹理路径（空串为已释放的层）
+    std::vector<int> refs;         // 每层的引用数
+    std::vector<int> freeLayers;   // 已释放、可以重新填入的层
+    std::vector<std::pair<int, unsigned char*>> pending; // 待上传的层（层索引，像素数据）
+};
+
+// 纹理层引用（数组索引 + 层索引，材质只需要记录它）
+struct TextureLayer {
+    int array = -1;
+    int layer = -1;
+    bool Valid() const { return array >= 0; }
+    int Packed() const { return Valid() ? (array << 16) | layer : -1; } // 顶点属性中的编码
+};
+
+// 着色器约定：uniform sampler2DArray textureArrays[8];（创建着色器时一次性指向firstUnit起的单元）
+// layout(location = 7) in ivec4 textureLayers; 依次为漫反射、高光、法线、高度纹理，值为(数组 << 16) | 层，-1表示没有
+// 每个网格绘制前用glVertexAttribI4i设置一次（属性数组不启用，整次绘制都是同一个值）
+
+// 纹理数组管理（导入时打包纹理，绘制时只传层索引）
+class TextureArrays {
+public:
+    static bool enable;                   // 导入/加载模型时是否打包成纹理数组
+    static const int firstUnit = 8;       // 纹理数组占用的起始纹理单元
+    static const int maxArrays = 8;       // 着色器中textureArrays的长度
+    static const GLuint layerAttribute = 7; // 纹理层的顶点属性位置
+    static void BindSamplers(GLuint program); // 着色器创建时设置一次采样器单元
+    static std::vector<TextureArray> arrays;
+    static string Key(const string& file, const string& directory); // 规范化的完整路径（不同目录的同名文件不冲突）
+    static TextureLayer Add(const string& file, const string& directory);
+    static TextureLayer Find(const string& key);
+    static void Release(const string& key); // 归还Add得到的一次引用，层空出后可复用，数组全空时删除
+    static size_t TotalBytes();
+    static void Build();                  // 上传待处理的层
+    static void Bind();                   // 绑定所有数组到固定纹理单元
+    static size_t Bytes(const TextureArray& a);
+    static void Report(std::ostream& out); // 驻留报告（数组、层、字节）
+    static void OnGUI();
+private:
+    static std::unordered_map<string, TextureLayer> lookup;
+    static int boundArrays;
+};
+
+// 静态成员初始化（纹理数组列表、路径索引、绑定状态）
+bool TextureArrays::enable = false;                                  // 默认关闭，导入/加载前打开即可打包
+std::vector<TextureArray> TextureArrays::arrays;                     // 所有纹理数组
+std::unordered_map<string, TextureLayer> TextureArrays::lookup;      // 纹理路径 -> 数组层
+int TextureArrays::boundArrays = 0;                                  // 当前已绑定到纹理单元的数组数量
+
+// 根据通道数推导像素格式
+static GLenum ChannelsToFormat(int channels) {
+    if (channels == 1) return GL_RED;
+    if (channels == 3) return GL_RGB;
+    return GL_RGBA;
+}
+
+string TextureArrays::Key(const string & file, const string & directory) {
+    return Vfs::Normalize(directory + '\\' + file);
+}
+
+// 添加纹理到纹理数组（尺寸和格式相同的纹理放进同一个数组，返回数组与层索引）
+TextureLayer TextureArrays::Add(const string & file, const string & directory) {
+    string key = Key(file, directory);
+    auto found = lookup.find(key);
+    if (found != lookup.end()) { // 已打包过，直接复用
+        arrays[found->second.array].refs[found->second.layer]++;
+        return found->second;
+    }
+
+    DecodedImage image;
+    if (!Vfs::LoadImage(directory + '\\' + file, image)) {
+        std::cout << "TextureArrays: failed to load " << file << std::endl;
+        return TextureLayer();
+    }
+    unsigned char* data = image.pixels;
+    int width = image.width, height = image.height, channels = image.channels;
+    GLenum format = ChannelsToFormat(channels);
+
+    // 查找尺寸格式一致且仍有空位的数组（已上传的数组只能填充到其容量或已释放的层）
+    int target = -1, empty = -1;
+    for (size_t i = 0; i < arrays.size(); i++) {
+        TextureArray& a = arrays[i];
+        if (a.id == 0 && a.layers.empty()) { // 整个数组已释放，索引保留给新数组（已有的层引用不变）
+            if (empty < 0) empty = (int)i;
+            continue;
+        }
+        if (a.width != width || a.height != height || a.format != format) continue;
+        if (a.id != 0 && a.freeLayers.empty() && (int)a.layers.size() >= a.capacity) continue;
+        target = (int)i;
+        break;
+    }
+    if (target < 0 && empty < 0 && (int)arrays.size() >= maxArrays) {
+        std::cout << "TextureArrays: too many arrays, " << file << " not packed" << std::endl;
+        stbi_image_free(data);
+        return TextureLayer();
+    }
+    if (target < 0) { // 没有合适的数组，新建一个
+        TextureArray a;
+        a.width = width;
+        a.height = height;
+        a.format = format;
+        a.channels = channels;
+        if (empty >= 0) arrays[empty] = a;
+        else arrays.push_back(a);
+        target = empty >= 0 ? empty : (int)arrays.size() - 1;
+    }
+
+    TextureArray& a = arrays[target];
+    TextureLayer layer{ target, (int)a.layers.size() };
+    if (!a.freeLayers.empty()) {
+        layer.layer = a.freeLayers.back();
+        a.freeLayers.pop_back();
+        a.layers[layer.layer] = key;
+        a.refs[layer.layer] = 1;
+    } else {
+        a.layers.push_back(key);
+        a.refs.push_back(1);
+    }
+    a.pending.push_back(std::make_pair(layer.layer, data)); // 等待Build时统一上传
+    lookup[key] = layer;
+    return layer;
+}
+
+// 查找已打包纹理的数组层（未打包返回无效层）
+TextureLayer TextureArrays::Find(const string & key) {
+    auto found = lookup.find(key);
+    return found != lookup.end() ? found->second : TextureLayer();
+}
+
+// 归还一次引用；层空出后留给同尺寸的纹理，数组中所有层都空出时删除整个数组
+void TextureArrays::Release(const string & key) {
+    auto found = lookup.find(key);
+    if (found == lookup.end()) return;
+    TextureLayer layer = found->second;
+    TextureArray& a = arrays[layer.array];
+    if (--a.refs[layer.layer] > 0) return;
+    lookup.erase(found);
+    a.layers[layer.layer].clear();
+    a.freeLayers.push_back(layer.layer);
+    for (auto it = a.pending.begin(); it != a.pending.end(); ++it)
+        if (it->first == layer.layer) { // 还没上传就被释放
+            stbi_image_free(it->second);
+            a.pending.erase(it);
+            break;
+        }
+    if (a.freeLayers.size() < a.layers.size()) return;
+    if (a.id) glDeleteTextures(1, &a.id);
+    arrays[layer.array] = TextureArray();
+    boundArrays = 0; // 单元上的数组已失效，下次绘制时重新绑定
+}
+
+size_t TextureArrays::TotalBytes() {
+    size_t total = 0;
+    for (auto& a : arrays) total += Bytes(a);
+    return total;
+}
+
+// 上传所有待处理的纹理层（新数组按2的幂预留容量，之后加载的纹理可直接填入空层）
+void TextureArrays::Build() {
+    for (auto& a : arrays) {
+        if (a.pending.empty()) continue;
+        if (a.id == 0) {
+            int capacity = 4;
+            while (capacity < (int)a.layers.size()) capacity *= 2;
+            a.capacity = capacity;
+            glGenTextures(1, &a.id);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, a.id);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, a.format, a.width, a.height, a.capacity, 0, a.format, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        } else {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, a.id);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // 单/三通道纹理行宽不一定是4的倍数
+        for (auto& p : a.pending) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, p.first, a.width, a.height, 1, a.format, GL_UNSIGNED_BYTE, p.second);
+            stbi_image_free(p.second); // 上传后释放CPU端像素
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        a.pending.clear();
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    boundArrays = 0; // 数组集合可能变化，下次绘制时重新绑定
+}
+
+// 采样器textureArrays[i]指向单元firstUnit + i（Uniform属于程序对象，只需设置一次）
+void TextureArrays::BindSamplers(GLuint program) {
+    for (int i = 0; i < maxArrays; i++) {
+        GLint location = glGetUniformLocation(program, ("textureArrays[" + std::to_string(i) + "]").c_str());
+        if (location < 0) return; // 没有声明（或没有使用）纹理数组
+        glUniform1i(location, firstUnit + i);
+    }
+}
+
+// 把所有纹理数组绑定到固定纹理单元（数组集合不变时不会重复绑定）
+void TextureArrays::Bind() {
+    if (boundArrays == (int)arrays.size()) return;
+    for (size_t i = 0; i < arrays.size(); i++) {
+        glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[i].id);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    boundArrays = (int)arrays.size();
+}
+
+// 计算纹理数组占用的显存（含完整mipmap链，约为基础层的4/3）
+size_t TextureArrays::Bytes(const TextureArray & a) {
+    size_t base = (size_t)a.width * a.height * a.channels * a.capacity;
+    return base + base / 3;
+}
+
+// 输出驻留报告（数组、层、字节数）
+void TextureArrays::Report(std::ostream & out) {
+    size_t total = 0;
+    for (size_t i = 0; i < arrays.size(); i++) {
+        const TextureArray& a = arrays[i];
+        size_t perLayer = Bytes(a) / (a.capacity > 0 ? a.capacity : 1);
+        out << "array " << i << " " << a.width << "x" << a.height << " channels " << a.channels
+            << " layers " << a.layers.size() << "/" << a.capacity << " bytes " << Bytes(a) << std::endl;
+        for (size_t l = 0; l < a.layers.size(); l++)
+            out << "  layer " << l << " " << a.layers[l] << " bytes " << perLayer << std::endl;
+        total += Bytes(a);
+    }
+    out << "total bytes " << total << std::endl;
+}
+
+// ImGui 调试界面（显示驻留报告）
+void TextureArrays::OnGUI() {
+    if (ImGui::TreeNode("TextureArrays")) {
+        ImGui::Checkbox("PackOnLoad", &enable); // 之后加载的模型是否打包
+        size_t total = 0;
+        for (size_t i = 0; i < arrays.size(); i++) {
+            const TextureArray& a = arrays[i];
+            total += Bytes(a);
+            if (ImGui::TreeNode((void*)(intptr_t)i, "array %d  %dx%d  %d/%d layers  %.2f MB", (int)i, a.width, a.height,
+                (int)a.layers.size(), a.capacity, Bytes(a) / (1024.0f * 1024.0f))) {
+                for (size_t l = 0; l < a.layers.size(); l++)
+                    ImGui::Text("layer %d: %s", (int)l, a.layers[l].c_str());
+                ImGui::TreePop();
+            }
+        }
+        ImGui::Text("total: %.2f MB", total / (1024.0f * 1024.0f));
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+#pragma endregion
+
+
+// ====================== Animation 骨骼动画 ======================
+#pragma region Animation
+
+const int MAX_SKIN_BONES = 128; // BoneData块中骨骼矩阵的数量（需与着色器一致）
+
+// 蒙皮顶点（独立的顶点缓冲挂在网格VAO上，Vertex格式不变）
+// 着色器约定：layout(location = 5) in uvec4 boneIds; layout(location = 6) in vec4 boneWeights;
+// uniform BoneData { mat4 bones[MAX_SKIN_BONES]; }; DrawData.flags.z（深度/阴影着色器为uniform int skinned）非0时做蒙皮，
+// depth.vert、shadow.vert与着色器的蒙皮计算顺序必须相同，深度预渲染才能保持逐位相同
+struct SkinVertex {
+    unsigned char bones[4];
+    float weights[4];
+};
+
+// 重采样后的关键帧通道（平移、旋转四元数、缩放）
+enum KeyChannel { KC_TX, KC_TY, KC_TZ, KC_RX, KC_RY, KC_RZ, KC_RW, KC_SX, KC_SY, KC_SZ, KC_COUNT };
+
+// 动画片段：导入时按固定频率重采样，每帧是 [通道][轨道] 的连续数组，
+// 采样时两帧之间直接做4路线性插值（旋转用归一化插值，相邻帧的四元数已调整到同一半球）
+struct AnimationClip {
+    string name;
+    float duration = 0;          // 秒
+    int frameCount = 0;          // 重采样帧数（首尾都包含）
+    int trackCount = 0, stride = 0; // 轨道数、按4补齐的长度
+    std::vector<int> trackNode;  // 轨道 -> 节点
+    std::vector<float> keys;     // frameCount * KC_COUNT * stride
+};
+
+// 骨架（节点按先序展开，父节点总在子节点之前，全局变换可以顺序计算）
+struct Skeleton {
+    std::vector<int> parent;
+    std::vector<mat4> bindLocal;        // 节点默认的局部变换
+    std::unordered_map<string, int> nodeIndex, boneIndex;
+    std::vector<int> boneNode;          // 骨骼 -> 节点
+    std::vector<mat4> offsets;          // 骨骼的逆绑定矩阵
+    std::vector<AnimationClip> clips;
+    std::vector<GLuint> skinBuffers;    // 各网格的蒙皮顶点缓冲
+    mat4 globalInverse = mat4(1);
+};
+
+// 动画组件（挂在带ModelRender的游戏对象上，播放模型中的动画片段）
+class Animator : public MonoBehavior {
+public:
+    string clipName;             // 为空时播放第一个片段
+    float speed = 1;
+    float time = 0;              // 当前播放时间（秒）
+    bool loop = true;
+    bool playing = true;
+    Animator();
+    ~Animator();
+    void Play(const string& clip, float startTime = 0);
+    void OnGUI() const override;
+    // 以下由Animation维护
+    const Model* model = nullptr;
+    int clip = -1;
+    int paletteOffset = -1;      // 在骨骼缓冲中的起始矩阵
+    int interval = 1;            // 每几帧计算一次姿势（按距离和可见性降频）
+    int phase = 0;               // 错开降频角色的计算帧
+    unsigned int visibleFrame = 0;
+    bool needsPose = true;
+};
+
+// 动画系统：所有角色的姿势并行计算，骨骼矩阵写在一个连续数组里，每帧整体上传一次
+class Animation {
+public:
+    static const GLuint boneBinding = 2;  // BoneData块绑定点
+    static float sampleRate;              // 重采样频率
+    static bool throttle;                 // 是否按距离和可见性降频
+    static float fullRateDistance;        // 此距离内每帧更新
+    static float throttleStep;            // 超出后每隔多远多降一帧
+    static int maxInterval;               // 最低更新频率（帧）
+    static int hiddenInterval;            // 上一帧不可见的角色至少隔几帧更新
+    static std::vector<Animator*> animators;
+    static void ImportSkeleton(const Model* model, const aiScene* scene); // 在处理网格之前调用
+    static bool ImportSkin(const Model* model, const aiMesh* mesh, GLuint vao); // 有骨骼的网格：创建蒙皮顶点缓冲
+    static bool IsSkinnedModel(const Model* model);
+    static void Remove(const Model* model);
+    static void Update();                 // 主相机每帧调用一次（阴影之前）
+    static void MarkVisible(const GameObject* object); // RenderPipeline：本帧在某个视图中可见
+    static bool IsSkinned(const GameObject* object);
+    static bool Bind(const GameObject* object); // 绑定该角色的骨骼矩阵区间（不是蒙皮角色返回false）
+    static void Forget(Animator* animator);
+    static void OnGUI();
+private:
+    static void Resolve(Animator* animator);
+    static void Layout();
+    static void Evaluate(const Animator* animator, const Skeleton& skeleton, mat4* nodes, float* sample, mat4* palette);
+    static std::unordered_map<const Model*, Skeleton> skeletons;
+    static std::unordered_map<const GameObject*, Animator*> byObject;
+    static std::vector<Animator*> work;
+    static std::vector<mat4> palettes;    // 所有角色的骨骼矩阵
+    static GLuint buffer;
+    static size_t bufferMatrices;         // 缓冲当前存储的矩阵数（绑定区间不能超出）
+    static bool layoutDirty;
+    static unsigned int frame;
+    static int evaluated;
+    static float updateMs;
+};
+
+// 静态成员初始化
+float Animation::sampleRate = 30.0f;
+bool Animation::throttle = true;
+float Animation::fullRateDistance = 15.0f;
+float Animation::throttleStep = 15.0f;
+int Animation::maxInterval = 4;
+int Animation::hiddenInterval = 8;
+std::vector<Animator*> Animation::animators;
+std::unordered_map<const Model*, Skeleton> Animation::skeletons;
+std::unordered_map<const GameObject*, Animator*> Animation::byObject;
+std::vector<Animator*> Animation::work;
+std::vector<mat4> Animation::palettes;
+GLuint Animation::buffer = 0;
+size_t Animation::bufferMatrices = 0;
+bool Animation::layoutDirty = true;
+unsigned int Animation::frame = 1;
+int Animation::evaluated = 0;
+float Animation::updateMs = 0;
+
+// Assimp矩阵是行主序
+static mat4 ToMat4(const aiMatrix4x4& m) {
+    mat4 result;
+    for (int r = 0; r < 4; r++)
+        for (int c = 0; c < 4; c++)
+            result[c][r] = m[r][c];
+    return result;
+}
+
+// 平移、旋转四元数（xyzw）、缩放合成局部矩阵
+static mat4 ComposeTQS(const vec3& t, const vec4& q, const vec3& s) {
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z, wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    mat4 m;
+    m[0] = vec4((1 - 2 * (yy + zz)) * s.x, 2 * (xy + wz) * s.x, 2 * (xz - wy) * s.x, 0);
+    m[1] = vec4(2 * (xy - wz) * s.y, (1 - 2 * (xx + zz)) * s.y, 2 * (yz + wx) * s.y, 0);
+    m[2] = vec4(2 * (xz + wy) * s.z, 2 * (yz - wx) * s.z, (1 - 2 * (xx + yy)) * s.z, 0);
+    m[3] = vec4(t, 1);
+    return m;
+}
+
+// 找到时间所在的关键帧区间，返回前一帧索引和插值系数
+template<typename Key>
+static unsigned int KeyAt(const Key* keys, unsigned int count, double time, float& alpha) {
+    alpha = 0;
+    if (count <= 1 || time <= keys[0].mTime) return 0;
+    const Key* next = std::upper_bound(keys, keys + count, time, [](double t, const Key& k) { return t < k.mTime; });
+    if (next == keys + count) return count - 1;
+    unsigned int i = (unsigned int)(next - keys) - 1;
+    double span = keys[i + 1].mTime - keys[i].mTime;
+    alpha = span > 0 ? (float)((time - keys[i].mTime) / span) : 0.0f;
+    return i;
+}
+
+// 两帧之间插值全部通道（SSE，4条轨道一组），再把旋转归一化
+static void SampleKeys(const float* a, const float* b, float t, int stride, float* out) {
+    __m128 w = _mm_set1_ps(t);
+    for (int i = 0; i < KC_COUNT * stride; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i), vb = _mm_loadu_ps(b + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), w)));
+    }
+    float* q[4] = { out + KC_RX * stride, out + KC_RY * stride, out + KC_RZ * stride, out + KC_RW * stride };
+    for (int i = 0; i < stride; i += 4) {
+        __m128 x = _mm_loadu_ps(q[0] + i), y = _mm_loadu_ps(q[1] + i), z = _mm_loadu_ps(q[2] + i), qw = _mm_loadu_ps(q[3] + i);
+        __m128 len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(qw, qw)));
+        __m128 inv = _mm_div_ps(_mm_set1_ps(1), _mm_sqrt_ps(len));
+        _mm_storeu_ps(q[0] + i, _mm_mul_ps(x, inv));
+        _mm_storeu_ps(q[1] + i, _mm_mul_ps(y, inv));
+        _mm_storeu_ps(q[2] + i, _mm_mul_ps(z, inv));
+        _mm_storeu_ps(q[3] + i, _mm_mul_ps(qw, inv));
+    }
+}
+
+// 导入骨架和动画片段（没有骨骼的模型不建立骨架，静态模型不受影响）
+void Animation::ImportSkeleton(const Model * model, const aiScene * scene) {
+    bool hasBones = false;
+    for (unsigned int i = 0; i < scene->mNumMeshes && !hasBones; i++) hasBones = scene->mMeshes[i]->HasBones();
+    if (!hasBones) return;
+    Skeleton& s = skeletons[model];
+    s = Skeleton();
+    std::vector<std::pair<const aiNode*, int>> stack = { { scene->mRootNode, -1 } };
+    while (!stack.empty()) {
+        auto entry = stack.back();
+        stack.pop_back();
+        int index = (int)s.parent.size();
+        s.parent.push_back(entry.second);
+        s.bindLocal.push_back(ToMat4(entry.first->mTransformation));
+        s.nodeIndex.emplace(entry.first->mName.C_Str(), index);
+        for (unsigned int i = entry.first->mNumChildren; i-- > 0;) stack.emplace_back(entry.first->mChildren[i], index);
+    }
+    s.globalInverse = inverse(s.bindLocal[0]);
+
+    for (unsigned int a = 0; a < scene->mNumAnimations; a++) {
+        const aiAnimation* anim = scene->mAnimations[a];
+        double ticks = anim->mTicksPerSecond > 0 ? anim->mTicksPerSecond : 25.0;
+        AnimationClip clip;
+        clip.name = anim->mName.length ? anim->mName.C_Str() : "clip" + std::to_string(a);
+        clip.duration = (float)(anim->mDuration / ticks);
+        clip.frameCount = (int)std::ceil(clip.duration * sampleRate) + 1;
+        std::vector<const aiNodeAnim*> channels;
+        for (unsigned int c = 0; c < anim->mNumChannels; c++) {
+            auto found = s.nodeIndex.find(anim->mChannels[c]->mNodeName.C_Str());
+            if (found == s.nodeIndex.end()) continue;
+            clip.trackNode.push_back(found->second);
+            channels.push_back(anim->mChannels[c]);
+        }
+        clip.trackCount = (int)channels.size();
+        clip.stride = (clip.trackCount + 3) & ~3;
+        clip.keys.assign((size_t)clip.frameCount * KC_COUNT * clip.stride, 0.0f);
+        for (int f = 0; f < clip.frameCount; f++) {
+            float* frameKeys = &clip.keys[(size_t)f * KC_COUNT * clip.stride];
+            double time = std::min(f / (double)sampleRate, (double)clip.duration) * ticks;
+            for (int k = clip.trackCount; k < clip.stride; k++) // 补齐的轨道保持单位变换
+                frameKeys[KC_RW * clip.stride + k] = frameKeys[KC_SX * clip.stride + k] = frameKeys[KC_SY * clip.stride + k] = frameKeys[KC_SZ * clip.stride + k] = 1;
+            for (int k = 0; k < clip.trackCount; k++) {
+                const aiNodeAnim* ch = channels[k];
+                float alpha;
+                aiVector3D t(0), sc(1);
+                aiQuaternion q;
+                if (ch->mNumPositionKeys) {
+                    unsigned int i = KeyAt(ch->mPositionKeys, ch->mNumPositionKeys, time, alpha);
+                    t = ch->mPositionKeys[i].mValue;
+                    if (alpha > 0) t += (ch->mPositionKeys[i + 1].mValue - t) * alpha;
+                }
+                if (ch->mNumRotationKeys) {
+                    unsigned int i = KeyAt(ch->mRotationKeys, ch->mNumRotationKeys, time, alpha);
+                    q = ch->mRotationKeys[i].mValue;
+                    if (alpha > 0) aiQuaternion::Interpolate(q, ch->mRotationKeys[i].mValue, ch->mRotationKeys[i + 1].mValue, alpha);
+                }
+                if (ch->mNumScalingKeys) {
+                    unsigned int i = KeyAt(ch->mScalingKeys, ch->mNumScalingKeys, time, alpha);
+                    sc = ch->mScalingKeys[i].mValue;
+                    if (alpha > 0) sc += (ch->mScalingKeys[i + 1].mValue - sc) * alpha;
+                }
+                q.Normalize();
+                if (f > 0) { // 与上一帧在同一半球，采样时线性插值不会绕远路
+                    const float* prev = frameKeys - KC_COUNT * clip.stride;
+                    float d = prev[KC_RX * clip.stride + k] * q.x + prev[KC_RY * clip.stride + k] * q.y
+                        + prev[KC_RZ * clip.stride + k] * q.z + prev[KC_RW * clip.stride + k] * q.w;
+                    if (d < 0) q = aiQuaternion(-q.w, -q.x, -q.y, -q.z);
+                }
+                float values[KC_COUNT] = { t.x, t.y, t.z, q.x, q.y, q.z, q.w, sc.x, sc.y, sc.z };
+                for (int c = 0; c < KC_COUNT; c++) frameKeys[c * clip.stride + k] = values[c];
+            }
+        }
+        s.clips.push_back(std::move(clip));
+    }
+    std::cout << "Animation: " << s.parent.size() << " nodes, " << s.clips.size() << " clips" << std::endl;
+}
+
+// 导入网格的骨骼权重（每个顶点保留权重最大的4个并归一化），蒙皮顶点缓冲挂到网格的VAO上
+bool Animation::ImportSkin(const Model * model, const aiMesh * mesh, GLuint vao) {
+    auto found = skeletons.find(model);
+    if (found == skeletons.end() || !mesh->HasBones()) return false;
+    Skeleton& s = found->second;
+    std::vector<SkinVertex> skin(mesh->mNumVertices, SkinVertex{ { 0, 0, 0, 0 }, { 0, 0, 0, 0 } });
+    for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+        const aiBone* bone = mesh->mBones[b];
+        auto inserted = s.boneIndex.emplace(bone->mName.C_Str(), (int)s.boneNode.size());
+        if (inserted.second) {
+            auto node = s.nodeIndex.find(bone->mName.C_Str());
+            s.boneNode.push_back(node != s.nodeIndex.end() ? node->second : 0);
+            s.offsets.push_back(ToMat4(bone->mOffsetMatrix));
+        }
+        int index = inserted.first->second;
+        if (index >= MAX_SKIN_BONES) {
+            std::cout << "Animation: more than " << MAX_SKIN_BONES << " bones, " << bone->mName.C_Str() << " ignored" << std::endl;
+            continue;
+        }
+        for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+            SkinVertex& v = skin[bone->mWeights[w].mVertexId];
+            int slot = 0; // 替换最小的权重
+            for (int i = 1; i < 4; i++) if (v.weights[i] < v.weights[slot]) slot = i;
+            if (bone->mWeights[w].mWeight <= v.weights[slot]) continue;
+            v.bones[slot] = (unsigned char)index;
+            v.weights[slot] = bone->mWeights[w].mWeight;
+        }
+    }
+    for (auto& v : skin) {
+        float sum = v.weights[0] + v.weights[1] + v.weights[2] + v.weights[3];
+        if (sum > 0) for (float& w : v.weights) w /= sum;
+    }
+
+    GLuint vbo;
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, skin.size() * sizeof(SkinVertex), skin.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, sizeof(SkinVertex), (void*)offsetof(SkinVertex, bones)); // 骨骼索引
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(SkinVertex), (void*)offsetof(SkinVertex, weights)); // 权重
+    glBindVertexArray(0);
+    s.skinBuffers.push_back(vbo);
+    return true;
+}
+
+bool Animation::IsSkinnedModel(const Model * model) {
+    return skeletons.count(model) != 0;
+}
+
+// 释放骨架（模型卸载时调用；还在使用它的角色重新查找）
+void Animation::Remove(const Model * model) {
+    auto found = skeletons.find(model);
+    if (found == skeletons.end()) return;
+    glDeleteBuffers((GLsizei)found->second.skinBuffers.size(), found->second.skinBuffers.data());
+    skeletons.erase(found);
+    for (auto a : animators)
+        if (a->model == model) { a->model = nullptr; a->clip = -1; }
+    layoutDirty = true;
+}
+
+// 查找角色的模型和片段
+void Animation::Resolve(Animator * a) {
+    if (!a->model) {
+        ModelRender* render = a->gameObject ? a->gameObject->GetComponent<ModelRender>() : nullptr;
+        if (!render || !render->model || !skeletons.count(render->model)) return;
+        a->model = render->model;
+        byObject[a->gameObject] = a;
+        layoutDirty = true;
+    }
+    if (a->clip >= 0) return;
+    const Skeleton& s = skeletons[a->model];
+    for (size_t i = 0; i < s.clips.size(); i++)
+        if (a->clipName.empty() || s.clips[i].name == a->clipName) { a->clip = (int)i; break; }
+    a->needsPose = true;
+}
+
+// 给每个角色分配骨骼缓冲中的区间（起点按Uniform缓冲偏移对齐，末尾留出一个完整区间，绑定时不越界）
+void Animation::Layout() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    int align = std::max(1, alignment / (int)sizeof(mat4));
+    int cursor = 0;
+    for (auto a : animators) {
+        a->paletteOffset = -1;
+        if (!a->model) continue;
+        int bones = std::min((int)skeletons[a->model].boneNode.size(), MAX_SKIN_BONES);
+        a->paletteOffset = cursor;
+        cursor += (bones + align - 1) / align * align;
+        a->needsPose = true;
+    }
+    palettes.assign(cursor + MAX_SKIN_BONES, mat4(1));
+    if (!buffer) glGenBuffers(1, &buffer);
+    layoutDirty = false;
+}
+
+// 计算一个角色的姿势：采样 -> 局部矩阵 -> 按层级求全局矩阵 -> 骨骼矩阵
+void Animation::Evaluate(const Animator * a, const Skeleton & s, mat4 * nodes, float * sample, mat4 * palette) {
+    memcpy(nodes, s.bindLocal.data(), s.bindLocal.size() * sizeof(mat4)); // 没有轨道的节点保持默认变换
+    if (a->clip >= 0) {
+        const AnimationClip& c = s.clips[a->clip];
+        float t = a->time * sampleRate;
+        int f0 = std::min((int)t, c.frameCount - 1), f1 = std::min(f0 + 1, c.frameCount - 1);
+        size_t frameSize = (size_t)KC_COUNT * c.stride;
+        SampleKeys(&c.keys[f0 * frameSize], &c.keys[f1 * frameSize], t - f0, c.stride, sample);
+        for (int k = 0; k < c.trackCount; k++) {
+            const float* v = sample + k;
+            nodes[c.trackNode[k]] = ComposeTQS(vec3(v[KC_TX * c.stride], v[KC_TY * c.stride], v[KC_TZ * c.stride]),
+                vec4(v[KC_RX * c.stride], v[KC_RY * c.stride], v[KC_RZ * c.stride], v[KC_RW * c.stride]),
+                vec3(v[KC_SX * c.stride], v[KC_SY * c.stride], v[KC_SZ * c.stride]));
+        }
+    }
+    for (size_t n = 1; n < s.parent.size(); n++) nodes[n] = nodes[s.parent[n]] * nodes[n];
+    int bones = std::min((int)s.boneNode.size(), MAX_SKIN_BONES);
+    for (int b = 0; b < bones; b++) palette[b] = s.globalInverse * nodes[s.boneNode[b]] * s.offsets[b];
+}
+
+// 推进所有角色的播放时间，按距离和可见性决定本帧要计算的角色，并行计算后整体上传
+void Animation::Update() {
+    auto start = std::chrono::high_resolution_clock::now();
+    frame++;
+    for (auto a : animators) Resolve(a);
+    bool laidOut = layoutDirty; // 重新布局后即使本帧没有角色要计算也要按新大小上传
+    if (layoutDirty) Layout();
+
+    vec3 eye = Setting::MainCamera ? Setting::MainCamera->gameObject->transform()->position : vec3(0);
+    work.clear();
+    for (auto a : animators) {
+        if (!a->model || !a->enable || !a->gameObject->enable) continue;
+        const Skeleton& s = skeletons[a->model];
+        if (a->playing && a->clip >= 0) {
+            float duration = s.clips[a->clip].duration;
+            a->time += Setting::deltaTime * a->speed;
+            if (a->loop && duration > 0) a->time = std::fmod(std::fmod(a->time, duration) + duration, duration);
+            else a->time = std::max(0.0f, std::min(a->time, duration));
+        }
+        a->interval = 1;
+        if (throttle) {
+            float distance = length(a->gameObject->transform()->position - eye);
+            if (distance > fullRateDistance)
+                a->interval = std::min(maxInterval, 1 + (int)((distance - fullRateDistance) / std::max(throttleStep, 0.01f)));
+            if (a->visibleFrame + 1 < frame) a->interval = std::max(a->interval, hiddenInterval); // 上一帧不在任何视图中
+        }
+        if (a->needsPose || (frame + a->phase) % a->interval == 0) work.push_back(a);
+    }
+    evaluated = (int)work.size();
+    if (!work.empty()) {
+        // 临时数据在主线程分配好，任务中只读写各自的区域
+        mat4** nodes = FrameArena::Allocate<mat4*>(work.size());
+        float** samples = FrameArena::Allocate<float*>(work.size());
+        for (size_t i = 0; i < work.size(); i++) {
+            const Skeleton& s = skeletons[work[i]->model];
+            nodes[i] = FrameArena::Allocate<mat4>(s.parent.size());
+            samples[i] = work[i]->clip >= 0 ? FrameArena::Allocate<float>((size_t)KC_COUNT * s.clips[work[i]->clip].stride) : nullptr;
+        }
+        Jobs::ParallelFor((int)work.size(), 8, [&](int begin, int end) {
+            for (int i = begin; i < end; i++)
+                Evaluate(work[i], skeletons.at(work[i]->model), nodes[i], samples[i], &palettes[work[i]->paletteOffset]);
+        });
+        for (auto a : work) a->needsPose = false;
+    }
+    if (!work.empty() || laidOut) {
+        // 整个数组一次上传（先丢弃旧存储，不等待GPU读完上一帧）；降频的角色沿用数组中上次的结果
+        GLsizeiptr size = palettes.size() * sizeof(mat4);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, size, palettes.data());
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        bufferMatrices = palettes.size();
+    }
+    updateMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Animation::MarkVisible(const GameObject * object) {
+    auto found = byObject.find(object);
+    if (found != byObject.end()) found->second->visibleFrame = frame;
+}
+
+bool Animation::IsSkinned(const GameObject * object) {
+    auto found = byObject.find(object);
+    return found != byObject.end() && found->second->paletteOffset >= 0;
+}
+
+bool Animation::Bind(const GameObject * object) {
+    auto found = byObject.find(object);
+    if (found == byObject.end() || found->second->paletteOffset < 0 || !buffer) return false;
+    if ((size_t)found->second->paletteOffset + MAX_SKIN_BONES > bufferMatrices) return false; // 布局后还没上传过
+    glBindBufferRange(GL_UNIFORM_BUFFER, boneBinding, buffer, (GLintptr)found->second->paletteOffset * sizeof(mat4), MAX_SKIN_BONES * sizeof(mat4));
+    return true;
+}
+
+void Animation::Forget(Animator * animator) {
+    animators.erase(std::remove(animators.begin(), animators.end(), animator), animators.end());
+    if (animator->gameObject) byObject.erase(animator->gameObject);
+    layoutDirty = true;
+}
+
+// ImGui 调试界面（显示降频设置和本帧计算量）
+void Animation::OnGUI() {
+    if (ImGui::TreeNode("Animation")) {
+        ImGui::Checkbox("Throttle", &throttle);
+        ImGui::DragFloat("FullRateDistance", &fullRateDistance, 1, 0, 500);
+        ImGui::DragFloat("ThrottleStep", &throttleStep, 1, 1, 500);
+        ImGui::SliderInt("MaxInterval", &maxInterval, 1, 16);
+        ImGui::SliderInt("HiddenInterval", &hiddenInterval, 1, 32);
+        ImGui::Text("animators: %d  evaluated: %d  %.2f ms", (int)animators.size(), evaluated, updateMs);
+        ImGui::Text("palettes: %.1f KB", palettes.size() * sizeof(mat4) / 1024.0f);
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+// 构造函数（设置组件名称，加入动画列表）
+Animator::Animator() {
+    name += "Animator"; // 设置组件名称
+    phase = (int)Animation::animators.size();
+    Animation::animators.push_back(this); // 模型在第一次Update时查找（ModelRender可能还没Start）
+}
+
+// 析构函数（从动画列表移除）
+Animator::~Animator() {
+    Animation::Forget(this);
+}
+
+// 切换片段（下一次Update时查找）
+void Animator::Play(const string & clip, float startTime) {
+    clipName = clip;
+    this->clip = -1;
+    time = startTime;
+    playing = true;
+}
+
+// ImGui 调试界面（显示片段和播放状态）
+void Animator::OnGUI() const {
+    MonoBehavior::OnGUI(); // 显示基类的启用状态复选框
+    ImGui::Text("clip: %s  time: %.2f  interval: %d", clipName.empty() ? "(first)" : clipName.c_str(), time, interval);
+    ImGui::DragFloat("speed", (float*)&speed, 0.05f, 0, 4);
+    ImGui::Checkbox("loop", (bool*)&loop);
+    ImGui::Checkbox("playing", (bool*)&playing);
+}
+
+#pragma endregion
+
+
+// ====================== ShadowSystem 阴影系统 ======================
+#pragma region ShadowSystem
+
+const int MAX_SHADOW_TILES = 16; // FrameData块中阴影矩阵的数量（需与着色器一致）
+
+// 阴影投射组件（挂在带ModelRender的游戏对象上；静态投射体会被缓存，动态投射体每帧叠加绘制）
+class ShadowCaster : public MonoBehavior {
+public:
+    bool isStatic = true;
+    // 上次记入阴影缓存时的状态（变化时先按它撤销，再按当前状态加入）
+    mat4 lastModel = mat4(0);
+    vec3 lastBoundsMin = vec3(0), lastBoundsMax = vec3(0); // 模型空间包围盒（析构时模型可能已不在）
+    bool wasActive = false;     // 是否参与投射（组件和游戏对象都启用且有模型）
+    bool wasStatic = true;
+    ShadowCaster();
+    ~ShadowCaster();
+    void OnGUI() const override;
+};
+
+// 阴影系统（所有阴影贴图共用一张图集：方向光4级级联，每个聚光灯一块）
+class ShadowSystem {
+public:
+    static const int atlasSize = 4096;    // 图集尺寸
+    static const int cellSize = 512;      // 分配单元（聚光灯占1格，级联占2x2格）
+    static const int cascadeCount = 4;
+    static const int atlasUnit = 7;       // 图集绑定的纹理单元
+    static bool enable;
+    static float shadowDistance;          // 级联覆盖的最远距离（与相机远平面取较小值）
+    static std::vector<ShadowCaster*> casters;
+    static mat4 tileMatrices[MAX_SHADOW_TILES]; // 世界空间 -> 图集UV的矩阵
+    static vec4 cascadeSplits;            // 各级联的远端距离（视空间）
+    static int tileCount;
+    static void Render(Camera* camera);   // 更新阴影图集
+    static ivec2 TilesOf(const AbstractLight* light); // 光源的首块索引和块数（无阴影返回-1）
+    static void Add(ShadowCaster* caster);        // 投射体构造时调用
+    static void Remove(ShadowCaster* caster);     // 投射体析构时调用（撤销它在缓存中的影响）
+    static void Invalidate(ShadowCaster* caster); // 启用状态或静态标记切换时调用（移动由TransformBatch记录）
+    static void OnGUI();
+    static int staticRedraws, dynamicDraws; // 本帧统计
+private:
+    struct Tile {
+        ivec4 rect;                // 图集中的像素区域
+        mat4 viewProj = mat4(0);   // 光源视图投影
+        bool staticValid = false;  // 缓存的静态深度是否有效
+        bool hadDynamic = false;   // 上一帧是否叠加过动态投射体
+        std::vector<ShadowCaster*> dynamicCasters; // 与块视锥相交的动态投射体（投射体变化时更新）
+    };
+    struct LightShadow {
+        const AbstractLight* light;
+        int firstTile, count;
+    };
+    static void Init();
+    static void Allocate();
+    static void FitCascades(Camera* camera, const AbstractLight* light, int firstTile);
+    static void FitSpot(const LightSpot* light, int tile);
+    static void DrawCasters(const Tile& tile, bool isStatic);
+    static bool Overlaps(const mat4& viewProj, const vec3& boundsMin, const vec3& boundsMax, const mat4& modelMat);
+    static void Withdraw(ShadowCaster* caster);  // 按上次记入的状态撤销
+    static bool Apply(ShadowCaster* caster);     // 撤销后按当前状态重新记入（还没挂上模型返回false）
+    static std::vector<Tile> tiles;
+    static std::vector<LightShadow> lightShadows;
+    static std::vector<const AbstractLight*> shadowLights; // 分配图集时的投射阴影光源（集合变化时重新分配）
+    static std::vector<ShadowCaster*> pending;   // 还没挂上模型的投射体（组件构造时尚未设置gameObject）
+    static std::vector<Transform*> moved;        // 本帧取出的变换变化记录
+    static GLuint staticAtlas, atlas, staticFbo, fbo;
+    static Shader* depthShader;
+};
+
+// 静态成员初始化
+bool ShadowSystem::enable = true;
+float ShadowSystem::shadowDistance = 100.0f;
+std::vector<ShadowCaster*> ShadowSystem::casters;
+mat4 ShadowSystem::tileMatrices[MAX_SHADOW_TILES];
+vec4 ShadowSystem::cascadeSplits = vec4(0);
+int ShadowSystem::tileCount = 0;
+int ShadowSystem::staticRedraws = 0;
+int ShadowSystem::dynamicDraws = 0;
+std::vector<ShadowSystem::Tile> ShadowSystem::tiles;
+std::vector<ShadowSystem::LightShadow> ShadowSystem::lightShadows;
+std::vector<const AbstractLight*> ShadowSystem::shadowLights;
+std::vector<ShadowCaster*> ShadowSystem::pending;
+std::vector<Transform*> ShadowSystem::moved;
+GLuint ShadowSystem::staticAtlas = 0, ShadowSystem::atlas = 0, ShadowSystem::staticFbo = 0, ShadowSystem::fbo = 0;
+Shader* ShadowSystem::depthShader = nullptr;
+
+// 光源类型判断（只有方向光和聚光灯投射阴影）
+static bool IsDirectional(const AbstractLight* light) { return dynamic_cast<const LightDirectional*>(light) != nullptr; }
+static bool IsSpot(const AbstractLight* light) { return dynamic_cast<const LightSpot*>(light) != nullptr; }
+
+// 创建深度图集（静态缓存图集 + 最终采样图集）
+void ShadowSystem::Init() {
+    GLuint* textures[2] = { &staticAtlas, &atlas };
+    GLuint* fbos[2] = { &staticFbo, &fbo };
+    for (int i = 0; i < 2; i++) {
+        glGenTextures(1, textures[i]);
+        glBindTexture(GL_TEXTURE_2D, *textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, atlasSize, atlasSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE); // 硬件PCF
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glGenFramebuffers(1, fbos[i]);
+        glBindFramebuffer(GL_FRAMEBUFFER, *fbos[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, *textures[i], 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, Headless::framebuffer); // 回到场景目标（窗口或离屏FBO）
+    depthShader = new Shader("shadow"); // 只输出深度的着色器
+}
+
+// 给当前的光源分配图集区域（投射阴影的光源集合变化时重新分配，所有缓存失效）
+void ShadowSystem::Allocate() {
+    const int cells = atlasSize / cellSize;
+    std::vector<bool> used(cells * cells, false);
+    // 在格子网格中找一块空闲的 n x n 区域
+    auto take = [&](int n, ivec4& rect) {
+        for (int y = 0; y + n <= cells; y += n)
+            for (int x = 0; x + n <= cells; x += n) {
+                bool free = true;
+                for (int j = 0; j < n && free; j++)
+                    for (int i = 0; i < n && free; i++)
+                        free = !used[(y + j) * cells + x + i];
+                if (!free) continue;
+                for (int j = 0; j < n; j++)
+                    for (int i = 0; i < n; i++)
+                        used[(y + j) * cells + x + i] = true;
+                rect = ivec4(x * cellSize, y * cellSize, n * cellSize, n * cellSize);
+                return true;
+            }
+        return false;
+    };
+
+    tiles.clear();
+    lightShadows.clear();
+    for (auto light : shadowLights) {
+        bool directional = IsDirectional(light);
+        int count = directional ? cascadeCount : 1;
+        if ((int)tiles.size() + count > MAX_SHADOW_TILES) break;
+        LightShadow ls{ light, (int)tiles.size(), count };
+        bool ok = true;
+        for (int i = 0; i < count && ok; i++) {
+            Tile tile;
+            ok = take(directional ? 2 : 1, tile.rect);
+            if (ok) tiles.push_back(tile);
+        }
+        if (!ok) { tiles.resize(ls.firstTile); break; } // 图集已满
+        lightShadows.push_back(ls);
+    }
+    tileCount = (int)tiles.size();
+}
+
+// 光源的阴影块（首块索引、块数）
+ivec2 ShadowSystem::TilesOf(const AbstractLight * light) {
+    for (auto& ls : lightShadows)
+        if (ls.light == light) return ivec2(ls.firstTile, ls.count);
+    return ivec2(-1, 0);
+}
+
+// 拟合方向光级联（分割点按相机近远平面对数/线性混合；中心对齐到纹素网格，相机小幅移动时矩阵不变，缓存保持有效）
+void ShadowSystem::FitCascades(Camera * camera, const AbstractLight * light, int firstTile) {
+    float nearPlane = camera->near, farPlane = std::min(camera->far, shadowDistance);
+    float aspect = camera->viewPort.z / camera->viewPort.w;
+    vec3 lightDir = -light->direction; // 光线传播方向
+    vec3 up = std::fabs(lightDir.y) > 0.99f ? vec3(0, 0, 1) : vec3(0, 1, 0);
+    mat4 lightView = lookAt(vec3(0), lightDir, up); // 只含旋转，级联平移在正交投影中处理
+    const float lambda = 0.75f;
+    float splitNear = nearPlane;
+    for (int c = 0; c < cascadeCount; c++) {
+        float p = (c + 1) / (float)cascadeCount;
+        float splitFar = lambda * nearPlane * std::pow(farPlane / nearPlane, p) + (1 - lambda) * (nearPlane + (farPlane - nearPlane) * p);
+        cascadeSplits[c] = splitFar;
+        // 分段视锥的包围球（半径只与视角和分割点有关，旋转相机时不变）
+        mat4 inv = inverse(perspective(radians(camera->angle), aspect, splitNear, splitFar) * viewMat);
+        vec3 corners[8], center(0);
+        for (int i = 0; i < 8; i++) {
+            vec4 p4 = inv * vec4((i & 1) ? 1 : -1, (i & 2) ? 1 : -1, (i & 4) ? 1 : -1, 1);
+            corners[i] = vec3(p4) / p4.w;
+            center += corners[i] / 8.0f;
+        }
+        float radius = 0;
+        for (auto& corner : corners) radius = std::max(radius, length(corner - center));
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        Tile& tile = tiles[firstTile + c];
+        float texel = 2 * radius / tile.rect.z;
+        vec3 lc = vec3(lightView * vec4(center, 1));
+        lc.x = std::floor(lc.x / texel) * texel;
+        lc.y = std::floor(lc.y / texel) * texel;
+        lc.z = std::floor(lc.z / (radius * 0.25f)) * (radius * 0.25f);
+        const float casterMargin = 50.0f; // 级联外但仍会投射阴影到级联内的距离
+        tile.viewProj = ortho(lc.x - radius, lc.x + radius, lc.y - radius, lc.y + radius,
+            -lc.z - radius - casterMargin, -lc.z + radius) * lightView;
+        splitNear = splitFar;
+    }
+}
+
+// 点光源/聚光灯的影响范围（衰减到1/256的距离）
+static float AttenuationRange(const LightPoint* light) {
+    if (light->quadratic > 0) // 解 quadratic*d^2 + linear*d + constant = 256
+        return (-light->linear + std::sqrt(light->linear * light->linear - 4 * light->quadratic * (light->constant - 256))) / (2 * light->quadratic);
+    if (light->linear > 0) return (256 - light->constant) / light->linear;
+    return 100.0f;
+}
+
+// 拟合聚光灯阴影（透视投影，远平面取光源影响范围）
+void ShadowSystem::FitSpot(const LightSpot * light, int tile) {
+    float range = AttenuationRange(light);
+    vec3 pos = light->gameObject->transform()->position;
+    vec3 lightDir = -light->direction;
+    vec3 up = std::fabs(lightDir.y) > 0.99f ? vec3(0, 0, 1) : vec3(0, 1, 0);
+    float fov = 2 * std::acos(clamp(light->cosPhyOuter, 0.01f, 1.0f));
+    tiles[tile].viewProj = perspective(fov, 1.0f, 0.1f, range) * lookAt(pos, pos + lightDir, up);
+}
+
+// 模型空间包围盒是否与光源视锥相交
+bool ShadowSystem::Overlaps(const mat4 & viewProj, const vec3 & boundsMin, const vec3 & boundsMax, const mat4 & modelMat) {
+    mat4 mvp = viewProj * modelMat;
+    int outside[6] = { 0 };
+    for (int i = 0; i < 8; i++) {
+        vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+        vec4 c = mvp * vec4(corner, 1);
+        outside[0] += c.x < -c.w; outside[1] += c.x > c.w;
+        outside[2] += c.y < -c.w; outside[3] += c.y > c.w;
+        outside[4] += c.z < -c.w; outside[5] += c.z > c.w;
+    }
+    for (int i = 0; i < 6; i++)
+        if (outside[i] == 8) return false; // 所有角点都在同一平面外侧
+    return true;
+}
+
+// 绘制与块视锥相交的静态或动态投射体（动态投射体直接取块的列表）
+void ShadowSystem::DrawCasters(const Tile & tile, bool isStatic) {
+    depthShader->setMat4("lightViewProj", tile.viewProj);
+    for (auto caster : isStatic ? casters : tile.dynamicCasters) {
+        if (caster->isStatic != isStatic || !caster->enable || !caster->gameObject->enable) continue;
+        auto render = caster->gameObject->GetComponent<ModelRender>();
+        if (!render || !render->model) continue;
+        mat4 modelMat = caster->gameObject->transform()->GetModelMaterix();
+        if (isStatic && !Overlaps(tile.viewProj, render->model->boundsMin, render->model->boundsMax, modelMat)) continue;
+        depthShader->setMat4("modelMat", modelMat);
+        depthShader->setInt("skinned", Animation::Bind(caster->gameObject)); // 蒙皮角色用本帧的骨骼矩阵
+        render->model->DrawDepth();
+        if (isStatic) staticRedraws++; else dynamicDraws++;
+    }
+}
+
+// 更新阴影图集（只重绘失效的静态缓存，动态投射体叠加在缓存副本上）
+void ShadowSystem::Render(Camera * camera) {
+    staticRedraws = dynamicDraws = 0;
+    if (!enable) return;
+    if (!depthShader) Init();
+
+    // 投射阴影的光源集合变化（增删或换了光源，不只是数量）时重新分配图集
+    std::vector<const AbstractLight*> lights;
+    for (auto light : *Setting::lights)
+        if (IsDirectional(light) || IsSpot(light)) lights.push_back(light); // 点光源暂不投射阴影
+    bool rebuildLists = false; // 动态列表需要整体重建（块重新分配或移动）
+    if (lights != shadowLights) {
+        shadowLights.swap(lights);
+        Allocate(); // 新块的静态缓存都是无效的
+        rebuildLists = true;
+    }
+
+    // 计算各块的光源矩阵，矩阵变化（光源移动、旋转或级联移动）时静态缓存失效
+    mat4* previous = FrameArena::Allocate<mat4>(tiles.size());
+    for (size_t i = 0; i < tiles.size(); i++) previous[i] = tiles[i].viewProj;
+    for (auto& ls : lightShadows) {
+        if (IsDirectional(ls.light)) FitCascades(camera, ls.light, ls.firstTile);
+        else FitSpot((const LightSpot*)ls.light, ls.firstTile);
+    }
+    for (size_t i = 0; i < tiles.size(); i++)
+        if (tiles[i].viewProj != previous[i]) {
+            tiles[i].staticValid = false;
+            rebuildLists = true;
+        }
+
+    // 只处理有变化的投射体：TransformBatch记录的移动，加上新增后还没挂上模型的
+    // （增删、启用和静态标记的切换在事件中已处理）；静态投射体只让新旧位置覆盖到的块失效
+    TransformBatch::TakeChanged(moved);
+    for (auto transform : moved) {
+        if (!transform->gameObject) continue;
+        auto caster = transform->gameObject->GetComponent<ShadowCaster>();
+        if (caster) Invalidate(caster);
+    }
+    pending.erase(std::remove_if(pending.begin(), pending.end(), [](ShadowCaster* caster) { return Apply(caster); }), pending.end());
+
+    // 块移动后按记入的状态重建动态列表（投射体的位置在上面已是最新的）
+    if (rebuildLists) {
+        for (auto& tile : tiles) tile.dynamicCasters.clear();
+        for (auto caster : casters) {
+            if (!caster->wasActive || caster->wasStatic) continue;
+            for (auto& tile : tiles)
+                if (Overlaps(tile.viewProj, caster->lastBoundsMin, caster->lastBoundsMax, caster->lastModel))
+                    tile.dynamicCasters.push_back(caster);
+        }
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f); // 深度偏移，减少阴影粉刺
+    depthShader->use();
+    for (size_t i = 0; i < tiles.size(); i++) {
+        Tile& tile = tiles[i];
+        bool redrawn = false;
+        if (!tile.staticValid) { // 重绘静态缓存
+            glBindFramebuffer(GL_FRAMEBUFFER, staticFbo);
+            glViewport(tile.rect.x, tile.rect.y, tile.rect.z, tile.rect.w);
+            glScissor(tile.rect.x, tile.rect.y, tile.rect.z, tile.rect.w);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            DrawCasters(tile, true);
+            tile.staticValid = true;
+            redrawn = true;
+        }
+        // 有动态投射体的块：复制静态缓存后叠加动态投射体
+        bool hasDynamic = !tile.dynamicCasters.empty();
+        if (redrawn || hasDynamic || tile.hadDynamic) { // 块内容没变化时不复制
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+            glDisable(GL_SCISSOR_TEST);
+            glBlitFramebuffer(tile.rect.x, tile.rect.y, tile.rect.x + tile.rect.z, tile.rect.y + tile.rect.w,
+                tile.rect.x, tile.rect.y, tile.rect.x + tile.rect.z, tile.rect.y + tile.rect.w, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            glEnable(GL_SCISSOR_TEST);
+            if (hasDynamic) {
+                glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+                glViewport(tile.rect.x, tile.rect.y, tile.rect.z, tile.rect.w);
+                glScissor(tile.rect.x, tile.rect.y, tile.rect.z, tile.rect.w);
+                DrawCasters(tile, false);
+            }
+        }
+        tile.hadDynamic = hasDynamic;
+
+        // 采样矩阵：NDC -> 图集中该块的UV
+        float s = (float)tile.rect.z / atlasSize;
+        mat4 toAtlas(1);
+        toAtlas[0][0] = 0.5f * s;
+        toAtlas[1][1] = 0.5f * s;
+        toAtlas[2][2] = 0.5f;
+        toAtlas[3] = vec4((float)tile.rect.x / atlasSize + 0.5f * s, (float)tile.rect.y / atlasSize + 0.5f * s, 0.5f, 1);
+        tileMatrices[i] = toAtlas * tile.viewProj;
+    }
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, Headless::framebuffer); // 回到场景目标（窗口或离屏FBO）
+
+    glActiveTexture(GL_TEXTURE0 + atlasUnit); // 图集常驻固定纹理单元
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// 撤销投射体上次记入的影响：静态的让覆盖到的块失效，动态的从各块列表中移出
+void ShadowSystem::Withdraw(ShadowCaster * caster) {
+    if (!caster->wasActive) return;
+    for (auto& tile : tiles) {
+        if (caster->wasStatic) {
+            if (Overlaps(tile.viewProj, caster->lastBoundsMin, caster->lastBoundsMax, caster->lastModel)) tile.staticValid = false;
+        } else {
+            auto& list = tile.dynamicCasters;
+            list.erase(std::remove(list.begin(), list.end(), caster), list.end());
+        }
+    }
+    caster->wasActive = false;
+}
+
+// 撤销旧状态后按当前状态记入：静态的让覆盖到的块失效，动态的加入相交块的列表
+bool ShadowSystem::Apply(ShadowCaster * caster) {
+    Withdraw(caster);
+    auto render = caster->gameObject ? caster->gameObject->GetComponent<ModelRender>() : nullptr;
+    if (!render || !render->model) return false;
+    bool active = caster->enable && caster->gameObject->enable;
+    mat4 modelMat = caster->gameObject->transform()->GetModelMaterix();
+    if (active) {
+        for (auto& tile : tiles) {
+            if (!Overlaps(tile.viewProj, render->model->boundsMin, render->model->boundsMax, modelMat)) continue;
+            if (caster->isStatic) tile.staticValid = false;
+            else tile.dynamicCasters.push_back(caster);
+        }
+    }
+    caster->lastModel = modelMat;
+    caster->lastBoundsMin = render->model->boundsMin;
+    caster->lastBoundsMax = render->model->boundsMax;
+    caster->wasActive = active;
+    caster->wasStatic = caster->isStatic;
+    return true;
+}
+
+void ShadowSystem::Add(ShadowCaster * caster) {
+    casters.push_back(caster);
+    pending.push_back(caster); // 构造时gameObject还没设置，下一次Render时记入
+}
+
+void ShadowSystem::Remove(ShadowCaster * caster) {
+    Withdraw(caster);
+    casters.erase(std::remove(casters.begin(), casters.end(), caster), casters.end());
+    pending.erase(std::remove(pending.begin(), pending.end(), caster), pending.end());
+}
+
+// 投射体状态变化：撤销旧状态再按新状态记入（没有模型时放回等待列表）
+void ShadowSystem::Invalidate(ShadowCaster * caster) {
+    if (!Apply(caster) && std::find(pending.begin(), pending.end(), caster) == pending.end())
+        pending.push_back(caster);
+}
+
+// ImGui 调试界面（显示阴影缓存统计）
+void ShadowSystem::OnGUI() {
+    if (ImGui::TreeNode("Shadows")) {
+        ImGui::Checkbox("EnableShadows", &enable);
+        ImGui::DragFloat("ShadowDistance", &shadowDistance, 1.0f, 10.0f, 1000.0f);
+        ImGui::Text("tiles: %d  casters: %d", tileCount, (int)casters.size());
+        ImGui::Text("static redraws: %d  dynamic draws: %d", staticRedraws, dynamicDraws);
+        ImGui::Text("splits: %.1f %.1f %.1f %.1f", cascadeSplits.x, cascadeSplits.y, cascadeSplits.z, cascadeSplits.w);
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+// 构造函数（注册到投射体列表）
+ShadowCaster::ShadowCaster() {
+    name += "ShadowCaster"; // 设置组件名称
+    ShadowSystem::Add(this);
+}
+
+// 析构函数（从投射体列表移除）
+ShadowCaster::~ShadowCaster() {
+    ShadowSystem::Remove(this);
+}
+
+// ImGui 调试界面（切换启用、静态/动态）
+void ShadowCaster::OnGUI() const {
+    bool wasEnabled = enable;
+    MonoBehavior::OnGUI();
+    bool toggled = enable != wasEnabled;
+    if (ImGui::Checkbox("Static", (bool*)&isStatic)) toggled = true;
+    if (toggled) ShadowSystem::Invalidate((ShadowCaster*)this);
+}
+
+#pragma endregion
+
+
+// ====================== UniformRing 常驻映射环形缓冲 ======================
+#pragma region UniformRing
+
+const int MAX_UNIFORM_LIGHTS = 16; // FrameData块中光源数组的长度（需与着色器一致）
+
+// 单个光源的Uniform数据（std140布局，与着色器FrameData块中的Light结构一致）
+struct LightUniform {
+    vec4 color;        // rgb：颜色 * 强度，w：光源类型
+    vec4 pos;          // xyz：位置
+    vec4 dirToLight;   // xyz：照射方向
+    vec4 attenuation;  // x：常数衰减 y：线性衰减 z：二次衰减
+    vec4 cone;         // x：内圆锥cos值 y：外圆锥cos值 z：首个阴影块（-1为无阴影） w：阴影块数
+};
+
+// 每帧数据（相机与光照，整帧只上传一次）
+struct FrameUniforms {
+    mat4 viewMat;
+    mat4 projMat;
+    vec4 cameraPos;
+    ivec4 lightCount;  // x：光源数量
+    LightUniform lights[MAX_UNIFORM_LIGHTS];
+    mat4 shadowMats[MAX_SHADOW_TILES]; // 世界空间 -> 阴影图集UV
+    vec4 cascadeSplits;                // 方向光各级联的远端距离
+};
+
+// 每次绘制的数据（模型矩阵与材质参数）
+struct DrawUniforms {
+    mat4 modelMat;
+    vec4 color;        // rgb：材质颜色，w：光泽度
+    ivec4 flags;       // x：是否启用高光 y：影响本次绘制的光源位掩码 z：是否蒙皮
+};
+
+// 环形缓冲（三帧轮转，每帧区域开头是FrameUniforms，之后是逐绘制的DrawUniforms）
+class UniformRing {
+public:
+    static const int frames = 3;             // 三重缓冲，CPU写第N帧时GPU仍可读前两帧
+    static const GLuint frameBinding = 0;    // FrameData块绑定点
+    static const GLuint drawBinding = 1;     // DrawData块绑定点
+    static int drawsPerFrame;                // 每帧最多绘制次数（某帧超出时下一帧起自动扩容）
+    static bool persistent;                  // 是否使用常驻映射（否则退回glBufferSubData）
+    static void BeginFrame();                // 切换到下一帧区域并上传每帧数据（主相机）
+    static GLintptr PushView(const mat4& view, const mat4& proj, const vec3& cameraPos); // 其他视图的每帧数据，返回偏移
+    static GLintptr MainView();              // 主相机每帧数据的偏移
+    static void BindView(GLintptr offset);
+    static void PushDraw(const DrawUniforms& draw); // 写入一次绘制的数据并绑定其偏移
+    static GLintptr WriteDraw(const DrawUniforms& draw); // 只写入，返回偏移（多个视图共用同一份数据）
+    static void BindDraw(GLintptr offset);
+    static int DrawsRemaining();             // 本帧区域还能写入的绘制数（超出的写到溢出缓冲）
+    static unsigned int drawLightMask;       // 下一次绘制的光源位掩码（由绘制方在Use之前设置）
+    static int drawSkinned;                  // 下一次绘制是否蒙皮（骨骼矩阵区间已由Animation::Bind绑定）
+    static GLintptr sharedDraw;              // 已写入的逐绘制数据偏移（>=0时Use只绑定不再写入）
+    static void BindBlocks(GLuint program);  // 把着色器的Uniform块绑定到固定绑定点
+private:
+    static void Init();
+    static void Grow();                      // 按上一帧的写入量重新分配缓冲
+    static void BindRange(GLuint binding, GLintptr offset, GLsizeiptr size); // 偏移在溢出缓冲中时绑定对应的缓冲
+    static void FillFrame(FrameUniforms& frame, const mat4& view, const mat4& proj, const vec3& cameraPos);
+    static GLintptr Write(const void* data, GLsizeiptr size, GLintptr stride);
+    static GLuint buffer;
+    static unsigned char* mapped;            // 常驻映射的地址（回退路径下为nullptr）
+    static GLsync fences[frames];
+    static int frameIndex;
+    static GLintptr frameSize, drawStride, regionSize, cursor;
+    static GLintptr frameWritten;            // 本帧写入的字节数（含溢出缓冲）
+    static bool overflowed;                  // 本帧是否超出过容量
+    // 溢出缓冲：本帧区域写满后余下的数据写在这里（每个大小为regionSize），偏移接在环形缓冲之后编号；
+    // 下一帧开始时删除（GL会等引用它的绘制完成后才真正释放）
+    static std::vector<GLuint> spills;
+    static GLintptr spillCursor;
+};
+
+// 静态成员初始化
+int UniformRing::drawsPerFrame = 4096;
+bool UniformRing::persistent = false;
+unsigned int UniformRing::drawLightMask = ~0u;
+int UniformRing::drawSkinned = 0;
+GLintptr UniformRing::sharedDraw = -1;
+GLuint UniformRing::buffer = 0;
+unsigned char* UniformRing::mapped = nullptr;
+GLsync UniformRing::fences[UniformRing::frames] = { nullptr, nullptr, nullptr };
+int UniformRing::frameIndex = -1;
+GLintptr UniformRing::frameWritten = 0;
+bool UniformRing::overflowed = false;
+std::vector<GLuint> UniformRing::spills;
+GLintptr UniformRing::spillCursor = 0;
+GLintptr UniformRing::frameSize = 0;
+GLintptr UniformRing::drawStride = 0;
+GLintptr UniformRing::regionSize = 0;
+GLintptr UniformRing::cursor = 0;
+
+// 按对齐要求向上取整
+static GLintptr AlignUp(GLintptr value, GLintptr alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// 初始化缓冲（支持GL_ARB_buffer_storage且不是llvmpipe时使用常驻映射）
+void UniformRing::Init() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    frameSize = AlignUp(sizeof(FrameUniforms), alignment);
+    drawStride = AlignUp(sizeof(DrawUniforms), alignment);
+    regionSize = frameSize + drawStride * drawsPerFrame;
+
+    // llvmpipe上的常驻映射走的是软件路径，反而比glBufferSubData慢
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    bool llvmpipe = renderer && strstr(renderer, "llvmpipe") != nullptr;
+    persistent = GLAD_GL_ARB_buffer_storage && !llvmpipe;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, regionSize * frames, nullptr, flags);
+        mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, regionSize * frames, flags);
+        if (!mapped) persistent = false;
+    }
+    if (!persistent)
+        glBufferData(GL_UNIFORM_BUFFER, regionSize * frames, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    std::cout << "UniformRing: " << (persistent ? "persistent mapped" : "glBufferSubData") << " path" << std::endl;
+}
+
+// 扩容：按上一帧实际写入量（至少翻倍）重新分配；旧缓冲直接删除，GL在引用它的绘制完成后才释放，
+// 新缓冲的各区域都没有被使用，旧的栅栏不再需要
+void UniformRing::Grow() {
+    int needed = (int)(frameWritten / drawStride) + 1;
+    drawsPerFrame = std::max(drawsPerFrame * 2, needed + needed / 4);
+    for (auto& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (mapped) {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        mapped = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    Init();
+    std::cout << "UniformRing: grown to " << drawsPerFrame << " draws per frame" << std::endl;
+}
+
+// 开始新的一帧（给上一帧区域加栅栏，等待即将复用的区域被GPU读完，再写入相机和光照）
+void UniformRing::BeginFrame() {
+    if (!spills.empty()) {
+        glDeleteBuffers((GLsizei)spills.size(), spills.data());
+        spills.clear();
+    }
+    if (buffer && overflowed) Grow();
+    overflowed = false;
+    frameWritten = 0;
+    if (!buffer) Init();
+    if (frameIndex >= 0 && persistent) {
+        if (fences[frameIndex]) glDeleteSync(fences[frameIndex]);
+        fences[frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    frameIndex = (frameIndex + 1) % frames;
+    if (persistent && fences[frameIndex]) {
+        // 通常三帧前的命令早已完成，这里很少真正阻塞
+        while (glClientWaitSync(fences[frameIndex], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(fences[frameIndex]);
+        fences[frameIndex] = nullptr;
+    }
+
+    // 填充每帧数据
+    FrameUniforms frame;
+    FillFrame(frame, viewMat, projMat, Setting::MainCamera->gameObject->transform()->position);
+
+    GLintptr base = regionSize * frameIndex;
+    if (persistent) {
+        memcpy(mapped + base, &frame, sizeof(frame));
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, base, sizeof(frame), &frame);
+    }
+    BindView(base);
+    cursor = frameSize;
+}
+
+// 相机和光照（光照与阴影矩阵对所有视图相同）
+void UniformRing::FillFrame(FrameUniforms & frame, const mat4 & view, const mat4 & proj, const vec3 & cameraPos) {
+    frame.viewMat = view;
+    frame.projMat = proj;
+    frame.cameraPos = vec4(cameraPos, 1);
+    int n = 0;
+    for (auto light : *Setting::lights) {
+        if (n == MAX_UNIFORM_LIGHTS) break;
+        light->ToUniform(frame.lights[n++]);
+    }
+    frame.lightCount = ivec4(n, 0, 0, 0);
+    for (int i = 0; i < ShadowSystem::tileCount; i++)
+        frame.shadowMats[i] = ShadowSystem::tileMatrices[i];
+    frame.cascadeSplits = ShadowSystem::cascadeSplits;
+}
+
+GLintptr UniformRing::MainView() {
+    return regionSize * frameIndex;
+}
+
+void UniformRing::BindView(GLintptr offset) {
+    BindRange(frameBinding, offset, sizeof(FrameUniforms));
+}
+
+void UniformRing::BindRange(GLuint binding, GLintptr offset, GLsizeiptr size) {
+    GLintptr ringSize = regionSize * frames;
+    if (offset < ringSize) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+        return;
+    }
+    GLintptr local = offset - ringSize;
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, spills[local / regionSize], local % regionSize, size);
+}
+
+// 其他视图的每帧数据写在本帧的绘制区域里
+GLintptr UniformRing::PushView(const mat4 & view, const mat4 & proj, const vec3 & cameraPos) {
+    FrameUniforms frame;
+    FillFrame(frame, view, proj, cameraPos);
+    return Write(&frame, sizeof(frame), frameSize);
+}
+
+// 在本帧区域中顺序写入一块数据，返回其在缓冲中的偏移
+GLintptr UniformRing::Write(const void * data, GLsizeiptr size, GLintptr stride) {
+    if (frameIndex < 0) BeginFrame();
+    frameWritten += stride;
+    if (cursor + stride > regionSize) {
+        // 本帧区域已满：已写入的视图和绘制数据可能还没被读取（共用数据在所有通道执行前就写好了），
+        // 不能回绕覆盖，余下的写到溢出缓冲（每帧只记录一次，下一帧开始前扩容）
+        if (!overflowed) std::cout << "UniformRing: more than " << drawsPerFrame << " draws in one frame" << std::endl;
+        overflowed = true;
+        if (spills.empty() || spillCursor + stride > regionSize) {
+            GLuint spill;
+            glGenBuffers(1, &spill);
+            glBindBuffer(GL_UNIFORM_BUFFER, spill);
+            glBufferData(GL_UNIFORM_BUFFER, regionSize, nullptr, GL_STREAM_DRAW);
+            spills.push_back(spill);
+            spillCursor = 0;
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, spills.back());
+        glBufferSubData(GL_UNIFORM_BUFFER, spillCursor, size, data);
+        GLintptr offset = regionSize * frames + regionSize * (GLintptr)(spills.size() - 1) + spillCursor;
+        spillCursor += stride;
+        return offset;
+    }
+    GLintptr offset = regionSize * frameIndex + cursor;
+    if (persistent) {
+        memcpy(mapped + offset, data, size);
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    }
+    cursor += stride;
+    return offset;
+}
+
+// 写入一次绘制的数据（只绑定偏移，不再逐个设置Uniform）
+void UniformRing::PushDraw(const DrawUniforms & draw) {
+    BindDraw(WriteDraw(draw));
+}
+
+GLintptr UniformRing::WriteDraw(const DrawUniforms & draw) {
+    return Write(&draw, sizeof(draw), drawStride);
+}
+
+void UniformRing::BindDraw(GLintptr offset) {
+    BindRange(drawBinding, offset, sizeof(DrawUniforms));
+}
+
+int UniformRing::DrawsRemaining() {
+    if (frameIndex < 0 || drawStride == 0) return 0;
+    return (int)((regionSize - cursor) / drawStride);
+}
+
+// 材质的逐绘制数据（模型矩阵、材质参数和光源掩码）
+DrawUniforms MaterialDrawUniforms(const AbstractMaterial * material, const mat4 & model) {
+    DrawUniforms draw;
+    draw.modelMat = model;
+    draw.color = vec4(material->color, material->shininess);
+    draw.flags = ivec4(material->specular ? 1 : 0, (int)UniformRing::drawLightMask, UniformRing::drawSkinned, 0);
+    return draw;
+}
+
+// 绑定着色器中的FrameData/DrawData/BoneData块（着色器没有这些块时不处理）
+void UniformRing::BindBlocks(GLuint program) {
+    GLuint frameBlock = glGetUniformBlockIndex(program, "FrameData");
+    GLuint drawBlock = glGetUniformBlockIndex(program, "DrawData");
+    GLuint boneBlock = glGetUniformBlockIndex(program, "BoneData");
+    if (frameBlock != GL_INVALID_INDEX) glUniformBlockBinding(program, frameBlock, frameBinding);
+    if (drawBlock != GL_INVALID_INDEX) glUniformBlockBinding(program, drawBlock, drawBinding);
+    if (boneBlock != GL_INVALID_INDEX) glUniformBlockBinding(program, boneBlock, Animation::boneBinding);
+}
+
+#pragma endregion
+
+
+// ====================== OcclusionCulling 软件遮挡剔除 ======================
+#pragma region OcclusionCulling
+
+// 遮挡体组件（挂在带ModelRender的游戏对象上，用模型数据构建低面数代理网格写入软件深度缓冲）
+// 代理网格必须保守：只能比真实网格少遮挡，不能填补门窗等开口或移动表面，所以只从原始三角形中挑选
+class Occluder : public MonoBehavior {
+public:
+    float minFaceSize = 0.05f;        // 保留的三角形面积下限（最长轴的比例的平方，小面对遮挡贡献很小）
+    int maxTriangles = 2048;          // 最多保留的三角形数（按面积从大到小）
+    std::vector<vec3> proxyVertices;  // 代理网格顶点（模型空间）
+    std::vector<unsigned int> proxyIndices;
+    const Model* builtFor = nullptr;  // 代理网格对应的模型（为空时重新构建）
+    Occluder();
+    ~Occluder();
+    void RealUpdate() override;
+    void OnGUI() const override;
+    void BuildProxy(const Model* model); // 挑选原始三角形中的大面
+};
+
+// 光栅化一行内的三角形跨度的SIMD内核（edge依次为三条边的A、B*py+C和深度的dzdx、dzdy*py+zc）
+typedef void(*RasterKernel)(float* row, int minX, int maxX, const float* edge);
+
+// 软件遮挡剔除（CPU光栅化遮挡体到低分辨率深度缓冲，再用包围盒测试物体是否被遮挡）
+class OcclusionCulling {
+public:
+    static const int width = 256, height = 128; // 深度缓冲分辨率
+    static const int tileSize = 8;              // 层次深度的块大小
+    static const int tilesX = width / tileSize, tilesY = height / tileSize;
+    static bool enable;
+    static std::vector<Occluder*> occluders;
+    static void Render(const mat4& view, const mat4& proj);      // 光栅化所有遮挡体
+    static bool IsVisible(const vec3& boundsMin, const vec3& boundsMax, const mat4& model); // 测试包围盒
+    static void OnGUI();
+    // 统计数据
+    static int occluderTriangles, tested, culled;
+    static float rasterMs;
+private:
+    struct ScreenTriangle {
+        float x[3], y[3], z[3];       // 屏幕坐标与NDC深度
+        int minX, maxX, minY, maxY;   // 屏幕包围盒
+    };
+    static void RasterizeBand(int firstRow, int lastRow);
+    static RasterKernel kernel;
+    static std::vector<ScreenTriangle> triangles;
+    static float* depth;              // 深度缓冲（每像素最近遮挡深度）
+    static float tileMax[tilesX * tilesY]; // 每块中最远的遮挡深度
+    static mat4 viewProj;
+};
+
+// 静态成员初始化
+bool OcclusionCulling::enable = true;
+std::vector<Occluder*> OcclusionCulling::occluders;
+int OcclusionCulling::occluderTriangles = 0;
+int OcclusionCulling::tested = 0;
+int OcclusionCulling::culled = 0;
+float OcclusionCulling::rasterMs = 0;
+RasterKernel OcclusionCulling::kernel = nullptr;
+std::vector<OcclusionCulling::ScreenTriangle> OcclusionCulling::triangles;
+float* OcclusionCulling::depth = nullptr;
+float OcclusionCulling::tileMax[OcclusionCulling::tilesX * OcclusionCulling::tilesY];
+mat4 OcclusionCulling::viewProj = mat4(1);
+
+// ---- SSE（4像素） ----
+static void RasterizeRowSSE(float* row, int minX, int maxX, const float* edge) {
+    __m128 offs = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 zero = _mm_setzero_ps();
+    for (int x = minX; x <= maxX; x += 4) {
+        __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offs);
+        __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge[0]), px), _mm_set1_ps(edge[1]));
+        __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge[2]), px), _mm_set1_ps(edge[3]));
+        __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge[4]), px), _mm_set1_ps(edge[5]));
+        __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+        if (_mm_movemask_ps(inside) == 0) continue;
+        __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge[6]), px), _mm_set1_ps(edge[7]));
+        __m128 d = _mm_load_ps(row + x);
+        __m128 nearer = _mm_min_ps(d, z);
+        _mm_store_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, d)));
+    }
+}
+
+// ---- AVX2（8像素） ----
+TARGET_AVX2 static void RasterizeRowAVX2(float* row, int minX, int maxX, const float* edge) {
+    __m256 offs = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    __m256 zero = _mm256_setzero_ps();
+    for (int x = minX; x <= maxX; x += 8) {
+        __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), offs);
+        __m256 e0 = _mm256_fmadd_ps(_mm256_set1_ps(edge[0]), px, _mm256_set1_ps(edge[1]));
+        __m256 e1 = _mm256_fmadd_ps(_mm256_set1_ps(edge[2]), px, _mm256_set1_ps(edge[3]));
+        __m256 e2 = _mm256_fmadd_ps(_mm256_set1_ps(edge[4]), px, _mm256_set1_ps(edge[5]));
+        __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ),
+            _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+        if (_mm256_movemask_ps(inside) == 0) continue;
+        __m256 z = _mm256_fmadd_ps(_mm256_set1_ps(edge[6]), px, _mm256_set1_ps(edge[7]));
+        __m256 d = _mm256_load_ps(row + x);
+        _mm256_store_ps(row + x, _mm256_blendv_ps(d, _mm256_min_ps(d, z), inside));
+    }
+}
+
+// 光栅化所有遮挡体（先并行变换三角形，再按行带并行光栅化，每个线程只写自己的行带）
+void OcclusionCulling::Render(const mat4 & view, const mat4 & proj) {
+    tested = culled = 0;
+    if (!enable) return;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!depth) depth = (float*)_mm_malloc(sizeof(float) * width * height, 32);
+    viewProj = proj * view;
+
+    // 变换遮挡体三角形到屏幕空间（跨越近平面的三角形直接丢弃，只会少遮挡不会误剔除）
+    triangles.clear();
+    for (auto occluder : occluders) {
+        if (!occluder->enable || !occluder->gameObject->enable || occluder->proxyIndices.empty()) continue;
+        mat4 mvp = viewProj * occluder->gameObject->transform()->GetModelMaterix();
+        vec4* clip = FrameArena::Allocate<vec4>(occluder->proxyVertices.size());
+        for (size_t i = 0; i < occluder->proxyVertices.size(); i++)
+            clip[i] = mvp * vec4(occluder->proxyVertices[i], 1);
+        for (size_t i = 0; i + 2 < occluder->proxyIndices.size(); i += 3) {
+            ScreenTriangle t;
+            bool valid = true;
+            for (int k = 0; k < 3; k++) {
+                const vec4& c = clip[occluder->proxyIndices[i + k]];
+                if (c.w < 1e-4f) { valid = false; break; }
+                t.x[k] = (c.x / c.w * 0.5f + 0.5f) * width;
+                t.y[k] = (c.y / c.w * 0.5f + 0.5f) * height;
+                t.z[k] = c.z / c.w;
+            }
+            if (!valid) continue;
+            t.minX = std::max(0, (int)std::floor(std::min({ t.x[0], t.x[1], t.x[2] })));
+            t.maxX = std::min(width - 1, (int)std::ceil(std::max({ t.x[0], t.x[1], t.x[2] })));
+            t.minY = std::max(0, (int)std::floor(std::min({ t.y[0], t.y[1], t.y[2] })));
+            t.maxY = std::min(height - 1, (int)std::ceil(std::max({ t.y[0], t.y[1], t.y[2] })));
+            if (t.minX > t.maxX || t.minY > t.maxY) continue; // 完全在屏幕外
+            triangles.push_back(t);
+        }
+    }
+    occluderTriangles = (int)triangles.size();
+
+    // 按块行切分屏幕，各线程独立光栅化并生成对应的层次深度
+    if (!kernel) kernel = CpuHasAVX2() ? RasterizeRowAVX2 : RasterizeRowSSE;
+    Jobs::ParallelFor(tilesY, 1, [](int begin, int end) {
+        RasterizeBand(begin * tileSize, end * tileSize);
+    });
+    rasterMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// 光栅化[firstRow, lastRow)行带内的所有三角形（逐行调用运行时选定的内核，SSE一次4像素，AVX2一次8像素）
+void OcclusionCulling::RasterizeBand(int firstRow, int lastRow) {
+    for (int y = firstRow; y < lastRow; y++)
+        std::fill(depth + y * width, depth + (y + 1) * width, 1.0f); // 清为远平面
+
+    for (const ScreenTriangle& t : triangles) {
+        int minY = std::max(t.minY, firstRow), maxY = std::min(t.maxY, lastRow - 1);
+        if (minY > maxY) continue;
+        // 统一为逆时针，遮挡体不做背面剔除
+        float area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.y[1] - t.y[0]) * (t.x[2] - t.x[0]);
+        if (std::fabs(area) < 1e-6f) continue;
+        int i1 = area > 0 ? 1 : 2, i2 = area > 0 ? 2 : 1;
+        float x0 = t.x[0], y0 = t.y[0], x1 = t.x[i1], y1 = t.y[i1], x2 = t.x[i2], y2 = t.y[i2];
+        // 边函数 E(p) = A*px + B*py + C，三条边都非负时像素在三角形内
+        float a0 = y1 - y2, b0 = x2 - x1, c0 = x1 * y2 - x2 * y1;
+        float a1 = y2 - y0, b1 = x0 - x2, c1 = x2 * y0 - x0 * y2;
+        float a2 = y0 - y1, b2 = x1 - x0, c2 = x0 * y1 - x1 * y0;
+        // 屏幕空间线性插值NDC深度：z = z0 + dzdx*(x-x0) + dzdy*(y-y0)
+        float invArea = 1.0f / std::fabs(area);
+        float z0 = t.z[0], z1 = t.z[i1], z2 = t.z[i2];
+        float dzdx = (a0 * z0 + a1 * z1 + a2 * z2) * invArea;
+        float dzdy = (b0 * z0 + b1 * z1 + b2 * z2) * invArea;
+        float zc = z0 - dzdx * x0 - dzdy * y0;
+        int minX = t.minX & ~7; // 按8像素对齐，便于整组读写
+
+        for (int y = minY; y <= maxY; y++) {
+            float py = y + 0.5f;
+            float edge[8] = { a0, b0 * py + c0, a1, b1 * py + c1, a2, b2 * py + c2, dzdx, dzdy * py + zc };
+            kernel(depth + y * width, minX, t.maxX, edge);
+        }
+    }
+
+    // 生成层次深度（每块记录最远的遮挡深度，物体最近点比它还远才算被遮挡）
+    for (int ty = firstRow / tileSize; ty < lastRow / tileSize; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            __m128 m = _mm_setzero_ps();
+            for (int y = ty * tileSize; y < (ty + 1) * tileSize; y++) {
+                const float* p = depth + y * width + tx * tileSize;
+                m = _mm_max_ps(m, _mm_max_ps(_mm_load_ps(p), _mm_load_ps(p + 4)));
+            }
+            m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+            m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+            tileMax[ty * tilesX + tx] = _mm_cvtss_f32(m);
+        }
+    }
+}
+
+// 测试模型空间包围盒是否可见（保守：无法判断时视为可见）
+bool OcclusionCulling::IsVisible(const vec3 & boundsMin, const vec3 & boundsMax, const mat4 & model) {
+    if (!enable || triangles.empty()) return true;
+    tested++;
+    mat4 mvp = viewProj * model;
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1e30f;
+    for (int i = 0; i < 8; i++) {
+        vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+        vec4 c = mvp * vec4(corner, 1);
+        if (c.w < 1e-4f) return true; // 包围盒跨越近平面
+        float x = (c.x / c.w * 0.5f + 0.5f) * width, y = (c.y / c.w * 0.5f + 0.5f) * height;
+        minX = std::min(minX, x); maxX = std::max(maxX, x);
+        minY = std::min(minY, y); maxY = std::max(maxY, y);
+        minZ = std::min(minZ, c.z / c.w);
+    }
+    if (maxX < 0 || maxY < 0 || minX >= width || minY >= height) return true; // 视锥剔除不归这里管
+    int tx0 = std::max(0, (int)minX / tileSize), tx1 = std::min(tilesX - 1, (int)maxX / tileSize);
+    int ty0 = std::max(0, (int)minY / tileSize), ty1 = std::min(tilesY - 1, (int)maxY / tileSize);
+    for (int ty = ty0; ty <= ty1; ty++)
+        for (int tx = tx0; tx <= tx1; tx++)
+            if (minZ <= tileMax[ty * tilesX + tx]) return true;
+    culled++;
+    return false;
+}
+
+// ImGui 调试界面（显示剔除统计）
+void OcclusionCulling::OnGUI() {
+    if (ImGui::TreeNode("OcclusionCulling")) {
+        ImGui::Checkbox("EnableOcclusion", &enable);
+        ImGui::Text("occluders: %d  triangles: %d", (int)occluders.size(), occluderTriangles);
+        ImGui::Text("tested: %d  culled: %d", tested, culled);
+        ImGui::Text("raster: %.3f ms (%d threads)  kernel: %s", rasterMs, Jobs::WorkerCount(), kernel == RasterizeRowAVX2 ? "AVX2" : "SSE2");
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+// 构造函数（注册到遮挡体列表）
+Occluder::Occluder() {
+    name += "Occluder"; // 设置组件名称
+    OcclusionCulling::occluders.push_back(this);
+}
+
+// 析构函数（从遮挡体列表移除）
+Occluder::~Occluder() {
+    auto& list = OcclusionCulling::occluders;
+    list.erase(std::remove(list.begin(), list.end(), this), list.end());
+}
+
+// 物理更新（ModelRender的模型加载或更换后构建代理网格）
+void Occluder::RealUpdate() {
+    MonoBehavior::RealUpdate();
+    auto render = gameObject->GetComponent<ModelRender>();
+    if (render && render->model && render->model != builtFor) BuildProxy(render->model);
+}
+
+// 保留面积最大的原始三角形（去掉三角形只会少遮挡，不会让开口被挡住）
+void Occluder::BuildProxy(const Model * model) {
+    builtFor = model;
+    proxyVertices.clear();
+    proxyIndices.clear();
+    vec3 size = model->boundsMax - model->boundsMin;
+    float extent = std::max(std::max(size.x, size.y), std::max(size.z, 1e-4f));
+    float minArea = minFaceSize * extent * minFaceSize * extent;
+    struct Face {
+        float area;
+        vec3 p[3];
+    };
+    std::vector<Face> faces;
+    for (const Mesh& mesh : model->meshes) {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            Face f;
+            for (int k = 0; k < 3; k++) f.p[k] = mesh.vertices[mesh.indices[i + k]].position;
+            f.area = 0.5f * length(cross(f.p[1] - f.p[0], f.p[2] - f.p[0]));
+            if (f.area >= minArea && f.area > 0) faces.push_back(f);
+        }
+    }
+    if ((int)faces.size() > maxTriangles) {
+        std::nth_element(faces.begin(), faces.begin() + maxTriangles, faces.end(),
+            [](const Face& a, const Face& b) { return a.area > b.area; });
+        faces.resize(maxTriangles);
+    }
+    // 位置完全相同的顶点共用（不改变任何位置）
+    std::unordered_map<string, unsigned int> welded;
+    for (const Face& f : faces) {
+        for (int k = 0; k < 3; k++) {
+            string key((const char*)&f.p[k], sizeof(vec3));
+            auto found = welded.find(key);
+            if (found == welded.end()) {
+                found = welded.emplace(key, (unsigned int)proxyVertices.size()).first;
+                proxyVertices.push_back(f.p[k]);
+            }
+            proxyIndices.push_back(found->second);
+        }
+    }
+}
+
+// ImGui 调试界面（显示代理网格规模）
+void Occluder::OnGUI() const {
+    MonoBehavior::OnGUI();
+    bool changed = ImGui::DragFloat("MinFaceSize", (float*)&minFaceSize, 0.005f, 0, 1);
+    changed |= ImGui::DragInt("MaxTriangles", (int*)&maxTriangles, 16, 16, 65536);
+    if (changed) ((Occluder*)this)->builtFor = nullptr; // 修改后重新构建代理网格
+    ImGui::Text("proxy: %d vertices, %d triangles", (int)proxyVertices.size(), (int)proxyIndices.size() / 3);
+}
+
+#pragma endregion
+
+
+// ====================== SpatialIndex 空间索引 ======================
+#pragma region SpatialIndex
+
+// 射线（世界空间）
+struct Ray {
+    vec3 origin;
+    vec3 direction;
+};
+
+// 动态包围盒树（叶子存放略微放大的包围盒，物体在放大范围内移动时不需要更新树；
+// 只检查变换发生变化的物体，射线、包围盒、球体、视锥和K近邻查询都是对数复杂度）
+class SpatialIndex {
+public:
+    static float margin;                                  // 叶子包围盒的放大量
+    static void Add(GameObject* object);                  // GameObject构造时加入
+    static void Remove(GameObject* object);               // GameObject析构时移除
+    static void Update();                                 // 每帧同步变换变化的物体
+    static GameObject* Raycast(const Ray& ray, const GameObject* ignore = nullptr, float* distance = nullptr);
+    static Ray ScreenPointToRay(const Camera* camera, vec2 screen); // 屏幕坐标（左上角为原点）-> 射线
+    static void QueryBox(const vec3& boxMin, const vec3& boxMax, std::vector<GameObject*>& out);
+    static void QuerySphere(const vec3& center, float radius, std::vector<GameObject*>& out);
+    static void QueryNearest(const vec3& point, int k, std::vector<GameObject*>& out); // 按到物体包围盒的距离由近到远取k个
+    static void QueryFrustum(const mat4& viewProj, std::vector<GameObject*>& out);
+    // 多视图剔除与光照分配（每帧：BeginFrame，每个视图CullView，全部视图剔除后AssignLights；结果按物体查表）
+    static void BeginFrame();
+    static void CullView(int view, const mat4& viewProj);
+    static void AssignLights();
+    static unsigned int ViewMask(const GameObject* object);  // 该物体在哪些视图中可见（第view位）
+    static unsigned int LightMask(const GameObject* object); // 影响该物体的光源位掩码（对应FrameData中的光源下标）
+    static void OnGUI();
+    static int nodeCount, moved, visibleCount;
+private:
+    struct Node {
+        vec3 boxMin, boxMax;
+        int parent = -1, left = -1, right = -1;
+        int item = -1;                 // 叶子对应的tracked下标
+        bool Leaf() const { return left < 0; }
+    };
+    struct Tracked {
+        GameObject* object;
+        ModelRender* render = nullptr; // 有模型时用模型包围盒
+        int leaf = -1;
+        vec3 position, rotation, scale; // 上次同步时的变换
+        unsigned int visibleFrame = 0, viewMask = 0, lightMask = 0;
+    };
+    static void WorldBounds(Tracked& t, vec3& boxMin, vec3& boxMax);
+    static int AllocateNode();
+    static void FreeNode(int node);
+    static void InsertLeaf(int leaf);
+    static void RemoveLeaf(int leaf);
+    static float Area(const vec3& boxMin, const vec3& boxMax);
+    template<typename Overlap, typename Visit> static void Traverse(Overlap overlap, Visit visit);
+    static std::vector<Node> nodes;
+    static std::vector<int> stack;       // 遍历栈（只在主线程查询，复用避免分配）
+    static int root, freeNode;
+    static std::vector<Tracked> tracked;
+    static std::unordered_map<const GameObject*, int> lookup;
+    static std::vector<int> visible;     // 本帧在任一视图中可见的tracked下标
+    static unsigned int frame;
+};
+
+// 静态成员初始化
+float SpatialIndex::margin = 0.5f;
+int SpatialIndex::nodeCount = 0;
+int SpatialIndex::moved = 0;
+int SpatialIndex::visibleCount = 0;
+std::vector<SpatialIndex::Node> SpatialIndex::nodes;
+std::vector<int> SpatialIndex::stack;
+int SpatialIndex::root = -1;
+int SpatialIndex::freeNode = -1;
+std::vector<SpatialIndex::Tracked> SpatialIndex::tracked;
+std::unordered_map<const GameObject*, int> SpatialIndex::lookup;
+std::vector<int> SpatialIndex::visible;
+unsigned int SpatialIndex::frame = 0;
+
+float SpatialIndex::Area(const vec3 & boxMin, const vec3 & boxMax) {
+    vec3 d = boxMax - boxMin;
+    return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+// 世界空间包围盒（模型包围盒经模型矩阵变换；没有模型的物体用位置处的小包围盒）
+void SpatialIndex::WorldBounds(Tracked & t, vec3 & boxMin, vec3 & boxMax) {
+    Transform* transform = t.object->transform();
+    if (!t.render) t.render = t.object->GetComponent<ModelRender>();
+    if (!t.render || !t.render->model) {
+        boxMin = transform->position - vec3(0.5f);
+        boxMax = transform->position + vec3(0.5f);
+        return;
+    }
+    mat4 model = transform->GetModelMaterix();
+    vec3 center = vec3(model * vec4((t.render->model->boundsMin + t.render->model->boundsMax) * 0.5f, 1));
+    vec3 extent = (t.render->model->boundsMax - t.render->model->boundsMin) * 0.5f;
+    vec3 worldExtent(0);
+    for (int i = 0; i < 3; i++) // |M| * extent
+        worldExtent += abs(vec3(model[i])) * extent[i];
+    boxMin = center - worldExtent;
+    boxMax = center + worldExtent;
+}
+
+int SpatialIndex::AllocateNode() {
+    nodeCount++;
+    if (freeNode >= 0) {
+        int node = freeNode;
+        freeNode = nodes[node].parent;
+        nodes[node] = Node();
+        return node;
+    }
+    nodes.push_back(Node());
+    return (int)nodes.size() - 1;
+}
+
+// 回收节点（空闲链表借用parent字段）
+void SpatialIndex::FreeNode(int node) {
+    nodes[node].parent = freeNode;
+    freeNode = node;
+    nodeCount--;
+}
+
+// 插入叶子（自顶向下按表面积增长选择兄弟节点）
+void SpatialIndex::InsertLeaf(int leaf) {
+    if (root < 0) {
+        root = leaf;
+        nodes[leaf].parent = -1;
+        return;
+    }
+    vec3 leafMin = nodes[leaf].boxMin, leafMax = nodes[leaf].boxMax;
+    int index = root;
+    while (!nodes[index].Leaf()) {
+        const Node& node = nodes[index];
+        float area = Area(node.boxMin, node.boxMax);
+        float combined = Area(min(node.boxMin, leafMin), max(node.boxMax, leafMax));
+        float cost = 2 * combined;                 // 在这里新建父节点的代价
+        float inheritance = 2 * (combined - area); // 下降时祖先增加的代价
+        float childCost[2];
+        int children[2] = { node.left, node.right };
+        for (int c = 0; c < 2; c++) {
+            const Node& child = nodes[children[c]];
+            float grown = Area(min(child.boxMin, leafMin), max(child.boxMax, leafMax));
+            childCost[c] = (child.Leaf() ? grown : grown - Area(child.boxMin, child.boxMax)) + inheritance;
+        }
+        if (cost < childCost[0] && cost < childCost[1]) break;
+        index = childCost[0] < childCost[1] ? children[0] : children[1];
+    }
+
+    // 为兄弟节点和新叶子创建父节点
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = AllocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].boxMin = min(leafMin, nodes[sibling].boxMin);
+    nodes[newParent].boxMax = max(leafMax, nodes[sibling].boxMax);
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    if (oldParent < 0) root = newParent;
+    else if (nodes[oldParent].left == sibling) nodes[oldParent].left = newParent;
+    else nodes[oldParent].right = newParent;
+
+    // 向上重算祖先包围盒
+    for (index = newParent; index >= 0; index = nodes[index].parent) {
+        Node& node = nodes[index];
+        node.boxMin = min(nodes[node.left].boxMin, nodes[node.right].boxMin);
+        node.boxMax = max(nodes[node.left].boxMax, nodes[node.right].boxMax);
+    }
+}
+
+// 移除叶子（兄弟节点顶替父节点）
+void SpatialIndex::RemoveLeaf(int leaf) {
+    if (leaf == root) {
+        root = -1;
+        return;
+    }
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+    if (grandParent < 0) {
+        root = sibling;
+        nodes[sibling].parent = -1;
+    } else {
+        if (nodes[grandParent].left == parent) nodes[grandParent].left = sibling;
+        else nodes[grandParent].right = sibling;
+        nodes[sibling].parent = grandParent;
+        for (int index = grandParent; index >= 0; index = nodes[index].parent) {
+            Node& node = nodes[index];
+            node.boxMin = min(nodes[node.left].boxMin, nodes[node.right].boxMin);
+            node.boxMax = max(nodes[node.left].boxMax, nodes[node.right].boxMax);
+        }
+    }
+    FreeNode(parent);
+}
+
+void SpatialIndex::Add(GameObject * object) {
+    Tracked t;
+    t.object = object;
+    t.position = vec3(FLT_MAX); // 首次Update时一定会插入树
+    lookup[object] = (int)tracked.size();
+    tracked.push_back(t);
+}
+
+void SpatialIndex::Remove(GameObject * object) {
+    auto found = lookup.find(object);
+    if (found == lookup.end()) return;
+    int i = found->second;
+    if (tracked[i].leaf >= 0) {
+        RemoveLeaf(tracked[i].leaf);
+        FreeNode(tracked[i].leaf);
+    }
+    lookup.erase(found);
+    visible.erase(std::remove(visible.begin(), visible.end(), i), visible.end());
+    if (i != (int)tracked.size() - 1) { // 与末尾交换删除
+        std::replace(visible.begin(), visible.end(), (int)tracked.size() - 1, i);
+        tracked[i] = tracked.back();
+        lookup[tracked[i].object] = i;
+        if (tracked[i].leaf >= 0) nodes[tracked[i].leaf].item = i;
+    }
+    tracked.pop_back();
+}
+
+// 同步变换（只有变换变化且超出叶子放大范围的物体才重新插入）
+void SpatialIndex::Update() {
+    moved = 0;
+    for (size_t i = 0; i < tracked.size(); i++) {
+        Tracked& t = tracked[i];
+        Transform* transform = t.object->transform();
+        if (!transform) continue;
+        bool hadModel = t.render && t.render->model;
+        if (t.leaf >= 0 && transform->position == t.position && transform->rotation == t.rotation && transform->scale == t.scale
+            && (hadModel || !t.object->GetComponent<ModelRender>())) continue;
+        t.position = transform->position;
+        t.rotation = transform->rotation;
+        t.scale = transform->scale;
+        vec3 boxMin, boxMax;
+        WorldBounds(t, boxMin, boxMax);
+        if (t.leaf >= 0) {
+            const Node& leaf = nodes[t.leaf];
+            if (all(greaterThanEqual(boxMin, leaf.boxMin)) && all(lessThanEqual(boxMax, leaf.boxMax))) continue; // 仍在放大范围内
+            RemoveLeaf(t.leaf);
+        } else {
+            t.leaf = AllocateNode();
+            nodes[t.leaf].item = (int)i;
+        }
+        nodes[t.leaf].boxMin = boxMin - vec3(margin);
+        nodes[t.leaf].boxMax = boxMax + vec3(margin);
+        InsertLeaf(t.leaf);
+        moved++;
+    }
+}
+
+// 通用遍历（overlap判断节点包围盒是否需要继续向下，visit处理叶子）
+template<typename Overlap, typename Visit>
+void SpatialIndex::Traverse(Overlap overlap, Visit visit) {
+    if (root < 0) return;
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[index];
+        if (!overlap(node.boxMin, node.boxMax)) continue;
+        if (node.Leaf()) {
+            visit(tracked[node.item]);
+        } else {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+}
+
+// 射线与包围盒求交（slab法，返回进入距离，未相交返回负数）
+static float RayBox(const Ray& ray, const vec3& invDir, const vec3& boxMin, const vec3& boxMax) {
+    vec3 t0 = (boxMin - ray.origin) * invDir, t1 = (boxMax - ray.origin) * invDir;
+    vec3 tNear = min(t0, t1), tFar = max(t0, t1);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+    return enter <= exit ? enter : -1;
+}
+
+// 射线检测（返回最近的物体，跳过ignore（通常是发出射线的相机）；命中判定使用物体的世界包围盒）
+GameObject * SpatialIndex::Raycast(const Ray & ray, const GameObject * ignore, float * distance) {
+    vec3 invDir = 1.0f / ray.direction;
+    float best = FLT_MAX;
+    GameObject* hit = nullptr;
+    Traverse([&](const vec3& boxMin, const vec3& boxMax) {
+        float t = RayBox(ray, invDir, boxMin, boxMax);
+        return t >= 0 && t < best; // 比已有命中更远的子树直接跳过
+    }, [&](Tracked& t) {
+        if (!t.object->enable || t.object == ignore) return;
+        vec3 boxMin, boxMax;
+        WorldBounds(t, boxMin, boxMax);
+        float d = RayBox(ray, invDir, boxMin, boxMax);
+        if (d >= 0 && d < best) { best = d; hit = t.object; }
+    });
+    if (distance) *distance = best;
+    return hit;
+}
+
+// 屏幕坐标转射线（用相机的视图和投影矩阵反投影）
+Ray SpatialIndex::ScreenPointToRay(const Camera * camera, vec2 screen) {
+    vec4 viewPort = camera->viewPort;
+    float x = (screen.x - viewPort.x) / viewPort.z * 2 - 1;
+    float y = ((Setting::windowSize.y - screen.y) - viewPort.y) / viewPort.w * 2 - 1; // GL视口原点在左下角
+    mat4 view = lookAt(camera->transform->position, camera->transform->position + camera->transform->Forward, camera->transform->WorldUp);
+    mat4 proj = perspective(radians(camera->angle), viewPort.z / viewPort.w, camera->near, camera->far);
+    mat4 inv = inverse(proj * view);
+    vec4 nearPoint = inv * vec4(x, y, -1, 1), farPoint = inv * vec4(x, y, 1, 1);
+    vec3 origin = vec3(nearPoint) / nearPoint.w;
+    return Ray{ origin, normalize(vec3(farPoint) / farPoint.w - origin) };
+}
+
+void SpatialIndex::QueryBox(const vec3 & boxMin, const vec3 & boxMax, std::vector<GameObject*>& out) {
+    Traverse([&](const vec3& mn, const vec3& mx) {
+        return all(lessThanEqual(mn, boxMax)) && all(greaterThanEqual(mx, boxMin));
+    }, [&](Tracked& t) { out.push_back(t.object); });
+}
+
+void SpatialIndex::QuerySphere(const vec3 & center, float radius, std::vector<GameObject*>& out) {
+    Traverse([&](const vec3& mn, const vec3& mx) {
+        vec3 d = center - clamp(center, mn, mx);
+        return dot(d, d) <= radius * radius;
+    }, [&](Tracked& t) { out.push_back(t.object); });
+}
+
+// K近邻（按包围盒距离优先展开，找到k个后剪掉更远的子树）
+void SpatialIndex::QueryNearest(const vec3 & point, int k, std::vector<GameObject*>& out) {
+    if (root < 0 || k <= 0) return;
+    auto boxDistance = [&](const vec3& boxMin, const vec3& boxMax) {
+        vec3 d = point - clamp(point, boxMin, boxMax);
+        return dot(d, d);
+    };
+    // 节点按放大后的包围盒距离（下界）排队；取出叶子时算到物体当前包围盒的精确距离，
+    // 以 -(物体+1) 重新入队，精确项出队时比队中所有下界都近，就是下一个最近的物体
+    typedef std::pair<float, int> Entry; // 距离平方，节点（负数为已算出精确距离的物体）
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    open.push(Entry(boxDistance(nodes[root].boxMin, nodes[root].boxMax), root));
+    int found = 0;
+    while (!open.empty() && found < k) {
+        Entry e = open.top();
+        open.pop();
+        if (e.second < 0) {
+            out.push_back(tracked[-e.second - 1].object);
+            found++;
+            continue;
+        }
+        const Node& node = nodes[e.second];
+        if (node.Leaf()) {
+            vec3 boxMin, boxMax;
+            WorldBounds(tracked[node.item], boxMin, boxMax);
+            open.push(Entry(boxDistance(boxMin, boxMax), -node.item - 1));
+        } else {
+            for (int child : { node.left, node.right })
+                open.push(Entry(boxDistance(nodes[child].boxMin, nodes[child].boxMax), child));
+        }
+    }
+}
+
+// 视锥查询（从视图投影矩阵提取六个平面）
+void SpatialIndex::QueryFrustum(const mat4 & viewProj, std::vector<GameObject*>& out) {
+    mat4 m = transpose(viewProj);
+    vec4 planes[6] = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2] };
+    Traverse([&](const vec3& mn, const vec3& mx) {
+        for (auto& p : planes) { // 包围盒在平面正方向上最远的角点也在外侧则不相交
+            vec3 corner(p.x > 0 ? mx.x : mn.x, p.y > 0 ? mx.y : mn.y, p.z > 0 ? mx.z : mn.z);
+            if (dot(vec3(p), corner) + p.w < 0) return false;
+        }
+        return true;
+    }, [&](Tracked& t) { out.push_back(t.object); });
+}
+
+// 新的一帧：同步变换变化的物体，清空上一帧的可见结果
+void SpatialIndex::BeginFrame() {
+    Update();
+    frame++;
+    visibleCount = 0;
+    visible.clear();
+}
+
+// 视锥剔除一个视图（只访问与视锥相交的子树，开销取决于该视图的可见物体数）
+void SpatialIndex::CullView(int view, const mat4 & viewProj) {
+    std::vector<GameObject*> hits;
+    QueryFrustum(viewProj, hits);
+    for (auto object : hits) {
+        int i = lookup[object];
+        Tracked& t = tracked[i];
+        if (t.visibleFrame != frame) { // 本帧第一次可见
+            t.visibleFrame = frame;
+            t.viewMask = 0;
+            t.lightMask = 0;
+            visible.push_back(i);
+        }
+        t.viewMask |= 1u << view;
+    }
+    visibleCount = (int)visible.size();
+}
+
+// 光照分配（每个点光源/聚光灯只查询其影响范围内的物体，只为至少一个视图中可见的物体记录）
+void SpatialIndex::AssignLights() {
+    std::vector<GameObject*> hits;
+    unsigned int global = 0; // 方向光影响所有物体
+    for (int i = 0; i < (int)Setting::lights->size() && i < 32; i++) {
+        AbstractLight* light = (*Setting::lights)[i];
+        auto point = dynamic_cast<LightPoint*>(light);
+        if (!point) { global |= 1u << i; continue; }
+        hits.clear();
+        QuerySphere(point->gameObject->transform()->position, AttenuationRange(point), hits);
+        for (auto object : hits) {
+            Tracked& t = tracked[lookup[object]];
+            if (t.visibleFrame == frame) t.lightMask |= 1u << i;
+        }
+    }
+    for (int i : visible)
+        tracked[i].lightMask |= global;
+}
+
+// 本帧新建、尚未插入树的物体按所有视图可见处理，并接受所有光源
+unsigned int SpatialIndex::ViewMask(const GameObject * object) {
+    auto found = lookup.find(object);
+    if (found == lookup.end() || tracked[found->second].leaf < 0) return ~0u;
+    const Tracked& t = tracked[found->second];
+    return t.visibleFrame == frame ? t.viewMask : 0;
+}
+
+unsigned int SpatialIndex::LightMask(const GameObject * object) {
+    auto found = lookup.find(object);
+    if (found == lookup.end() || tracked[found->second].leaf < 0) return ~0u;
+    return tracked[found->second].lightMask;
+}
+
+// ImGui 调试界面（显示树规模和本帧更新数量）
+void SpatialIndex::OnGUI() {
+    if (ImGui::TreeNode("SpatialIndex")) {
+        ImGui::DragFloat("Margin", &margin, 0.05f, 0, 5);
+        ImGui::Text("objects: %d  nodes: %d", (int)tracked.size(), nodeCount);
+        ImGui::Text("moved: %d  visible: %d", moved, visibleCount);
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+#pragma endregion
+
+
+// ====================== AssetCache 共享资源缓存 ======================
+#pragma region AssetCache
+
+// 后台线程导入的模型：导入器持有aiScene，材质纹理已解码（键为Vfs::Normalize的路径）
+struct ImportedModel {
+    Assimp::Importer* importer = nullptr;
+    std::vector<std::pair<string, DecodedImage>> images;
+};
+
+// 共享资源缓存（同一路径的模型/同名着色器只加载一次，引用计数归零时释放）
+class AssetCache {
+public:
+    static Model* AcquireModel(const string& path);
+    // 后台线程：导入模型并解码其材质纹理，之后创建该模型时主线程只做数据转换和上传（已加载或已导入的跳过）
+    static void Import(const string& path);
+    static bool TakeImport(const string& path, ImportedModel& out); // 主线程取走导入结果，用完FreeImport
+    static void DropImport(const string& path);                     // 导入结果不再需要时释放
+    static void FreeImport(ImportedModel& import);
+    static const unsigned int importFlags;                          // 翻转UV、三角化、计算切线空间、限制骨骼权重数、合并顶点、缓存优化
+    static const std::pair<aiTextureType, const char*> textureTypes[4]; // 模型加载的材质纹理类型
+    static void Release(Model* model);
+    static Shader* AcquireShader(const string& name);
+    static void Release(Shader* shader);
+    static size_t FileSize(const string& path);
+    static size_t meshBytes;             // 已加载模型的网格显存
+    static size_t ResidentBytes();       // 网格与所有纹理的显存（WorldStreamer的内存预算按它计算）
+    static int ModelCount() { return (int)models.size(); }
+    static int ShaderCount() { return (int)shaders.size(); }
+private:
+    template<typename T> struct Entry {
+        T* asset;
+        int refs;
+        size_t bytes;
+    };
+    static std::unordered_map<string, Entry<Model>> models;
+    static std::unordered_map<string, Entry<Shader>> shaders;
+    static std::unordered_map<const void*, string> keys; // 资源 -> 路径，释放时反查
+    static std::mutex importMutex;                       // 保护imports和residentModels（后台线程也会访问）
+    static std::unordered_map<string, ImportedModel> imports;
+    static std::unordered_map<string, bool> residentModels;
+};
+
+// 静态成员初始化
+size_t AssetCache::meshBytes = 0;
+// 合并相同顶点并按顶点缓存重排三角形：网格簇按索引顺序切分，两者保证每簇接近顶点上限内的最多三角形且空间上紧凑
+const unsigned int AssetCache::importFlags = aiProcess_FlipUVs | aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_LimitBoneWeights
+    | aiProcess_JoinIdenticalVertices | aiProcess_ImproveCacheLocality;
+const std::pair<aiTextureType, const char*> AssetCache::textureTypes[4] = {
+    { aiTextureType_DIFFUSE, "texture_diffuse" }, { aiTextureType_SPECULAR, "texture_specular" },
+    { aiTextureType_HEIGHT, "texture_normal" }, { aiTextureType_AMBIENT, "texture_height" } };
+std::mutex AssetCache::importMutex;
+std::unordered_map<string, ImportedModel> AssetCache::imports;
+std::unordered_map<string, bool> AssetCache::residentModels;
+std::unordered_map<string, AssetCache::Entry<Model>> AssetCache::models;
+std::unordered_map<string, AssetCache::Entry<Shader>> AssetCache::shaders;
+std::unordered_map<const void*, string> AssetCache::keys;
+
+size_t AssetCache::FileSize(const string & path) {
+    return Vfs::Size(path);
+}
+
+size_t AssetCache::ResidentBytes() {
+    return meshBytes + Vfs::textureBytes + TextureStreamer::residentBytes + TextureArrays::TotalBytes();
+}
+
+Model * AssetCache::AcquireModel(const string & path) {
+    auto found = models.find(path);
+    if (found != models.end()) {
+        found->second.refs++;
+        DropImport(path); // 后台可能在模型加载前开始导入了同一个文件
+        return found->second.asset;
+    }
+    Model* model = new Model(path); // 有后台导入结果时LoadModel直接使用
+    size_t bytes = model->GpuBytes();
+    models[path] = Entry<Model>{ model, 1, bytes };
+    keys[model] = path;
+    meshBytes += bytes;
+    std::lock_guard<std::mutex> lock(importMutex);
+    residentModels[path] = true;
+    return model;
+}
+
+void AssetCache::Import(const string & path) {
+    {
+        std::lock_guard<std::mutex> lock(importMutex);
+        if (residentModels.count(path) || imports.count(path)) return;
+    }
+    ImportedModel result;
+    result.importer = new Assimp::Importer();
+    result.importer->SetIOHandler(new VfsIOSystem());
+    const aiScene* scene = result.importer->ReadFile(path, importFlags);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        FreeImport(result); // 主线程加载时会再试一次并报告错误
+        return;
+    }
+    // 和Model::loadMaterialTextures相同的纹理路径（没有纹理时用默认纹理，有压缩纹理的由TextureStreamer加载）
+    string directory = path.substr(0, path.find_last_of("\\/"));
+    std::unordered_map<string, bool> seen;
+    auto decode = [&](const string& file) {
+        string texturePath = directory + '\\' + file;
+        string key = Vfs::Normalize(texturePath);
+        if (seen[key] || !TextureStreamer::Resolve(file, directory).empty()) return;
+        seen[key] = true;
+        DecodedImage image;
+        if (Vfs::DecodeImage(texturePath, image)) result.images.emplace_back(key, image);
+    };
+    for (unsigned int m = 0; m < scene->mNumMaterials; m++) {
+        aiMaterial* material = scene->mMaterials[m];
+        for (auto& type : textureTypes) {
+            unsigned int count = material->GetTextureCount(type.first);
+            if (count == 0) decode(string(type.second) + ".jpg");
+            for (unsigned int i = 0; i < count; i++) {
+                aiString str;
+                material->GetTexture(type.first, i, &str);
+                decode(str.C_Str());
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(importMutex);
+    if (residentModels.count(path)) { // 导入期间主线程已经加载了
+        FreeImport(result);
+        return;
+    }
+    imports[path] = std::move(result);
+}
+
+bool AssetCache::TakeImport(const string & path, ImportedModel & out) {
+    std::lock_guard<std::mutex> lock(importMutex);
+    auto found = imports.find(path);
+    if (found == imports.end()) return false;
+    out = std::move(found->second);
+    imports.erase(found);
+    return true;
+}
+
+void AssetCache::DropImport(const string & path) {
+    ImportedModel dropped;
+    if (TakeImport(path, dropped)) FreeImport(dropped);
+}
+
+void AssetCache::FreeImport(ImportedModel & import) {
+    delete import.importer; // 同时释放aiScene和IO处理器
+    import.importer = nullptr;
+    for (auto& image : import.images) stbi_image_free(image.second.pixels);
+    import.images.clear();
+}
+
+void AssetCache::Release(Model * model) {
+    auto key = keys.find(model);
+    if (key == keys.end()) return;
+    auto found = models.find(key->second);
+    if (--found->second.refs > 0) return;
+    meshBytes -= found->second.bytes;
+    {
+        std::lock_guard<std::mutex> lock(importMutex);
+        residentModels.erase(key->second);
+    }
+    models.erase(found);
+    keys.erase(key);
+    delete model;
+}
+
+Shader * AssetCache::AcquireShader(const string & name) {
+    auto found = shaders.find(name);
+    if (found != shaders.end()) {
+        found->second.refs++;
+        return found->second.asset;
+    }
+    Shader* shader = new Shader(name);
+    shaders[name] = Entry<Shader>{ shader, 1, 0 };
+    keys[shader] = name;
+    return shader;
+}
+
+void AssetCache::Release(Shader * shader) {
+    auto key = keys.find(shader);
+    if (key == keys.end()) return;
+    auto found = shaders.find(key->second);
+    if (--found->second.refs > 0) return;
+    shaders.erase(found);
+    keys.erase(key);
+    delete shader;
+}
+
+#pragma endregion
+
+
+// ====================== WorldStreamer 世界分块流式加载 ======================
+#pragma region WorldStreamer
+
+// 世界分块流式加载（场景按XZ网格切成单元，每个单元一个json文件 cell_<x>_<z>.json：
+// { "objects": [ { "name", "type", "position", "rotation", "scale", "model", "shader" } ] }，
+// type为GameObject::Type的数值，带model的对象会加上ModelRender）
+// 后台线程读取并解析单元文件、导入模型并解码纹理；主线程每帧在预算内分批创建/销毁对象
+// 退出前调用 Shutdown 停止后台线程（启动线程时也登记到atexit，没有调用时在静态对象析构之前停止）
+class WorldStreamer {
+public:
+    static bool enable;
+    static string directory;           // 单元文件目录
+    static float cellSize;             // 单元边长
+    static int loadRadius;             // 相机所在单元周围多少圈内加载
+    static int hysteresis;             // 超出加载半径多少圈才卸载（避免在边界来回加载）
+    static size_t memoryBudget;        // 显存预算（已加载的网格和纹理；待创建的单元按文件大小估计）
+    static int objectsPerFrame;        // 每帧最多创建/销毁的对象数
+    static float msPerFrame;           // 每帧用于创建/销毁的时间预算
+    static void Update();              // RenderPipeline::RenderFrame末尾调用（上一轮提交已绘制完，没有待绘制的引用）
+    static void Shutdown();            // 通知后台线程退出并等待（正在导入的单元做完为止，其余请求丢弃）
+    static void OnGUI();
+private:
+    enum class State { Unloaded, Requested, Parsed, Instantiating, Loaded, Unloading };
+    struct CellObject {
+        string name;
+        int type;
+        vec3 position, rotation, scale;
+        string model, shader;
+        string animation;                 // 非空时添加Animator播放该片段（"*"为第一个片段）
+    };
+    struct Cell {
+        int x, z;
+        State state = State::Unloaded;
+        std::vector<CellObject> data;     // 解析结果
+        size_t bytes = 0;                 // 本单元引用的模型文件大小（预算估计）
+        size_t next = 0;                  // 下一个要创建的对象
+        std::vector<std::pair<GameObject*, std::list<GameObject*>::iterator>> objects;
+    };
+    struct Parsed {
+        long long key;
+        std::vector<CellObject> data;
+        size_t bytes;
+    };
+    static long long Key(int x, int z) { return ((long long)x << 32) ^ (unsigned int)z; }
+    static string CellPath(int x, int z);
+    static string ModelPath(const string& model);
+    static void DropImports(const Cell& cell);
+    static void LoaderLoop();
+    static void Request(Cell& cell);
+    static bool Instantiate(Cell& cell);  // 创建下一个对象，全部创建完返回true
+    static bool Destroy(Cell& cell);      // 销毁一个对象，全部销毁完返回true
+    static std::unordered_map<long long, Cell> cells;
+    static std::thread loader;
+    static std::mutex mutex;
+    static std::condition_variable wake;
+    static bool stopping;                 // 由mutex保护
+    static std::deque<std::pair<long long, string>> requests; // 按优先级（由近到远）排好
+    static std::vector<Parsed> results;
+    static size_t pendingBytes;           // 正在创建中的单元的预算
+};
+
+// 静态成员初始化
+bool WorldStreamer::enable = false;
+string WorldStreamer::directory; // 为空时使用 Setting::settingDir\cells
+float WorldStreamer::cellSize = 64.0f;
+int WorldStreamer::loadRadius = 2;
+int WorldStreamer::hysteresis = 1;
+size_t WorldStreamer::memoryBudget = (size_t)512 << 20;
+int WorldStreamer::objectsPerFrame = 16;
+float WorldStreamer::msPerFrame = 2.0f;
+std::unordered_map<long long, WorldStreamer::Cell> WorldStreamer::cells;
+std::thread WorldStreamer::loader;
+std::mutex WorldStreamer::mutex;
+std::condition_variable WorldStreamer::wake;
+bool WorldStreamer::stopping = false;
+std::deque<std::pair<long long, string>> WorldStreamer::requests;
+std::vector<WorldStreamer::Parsed> WorldStreamer::results;
+size_t WorldStreamer::pendingBytes = 0;
+
+string WorldStreamer::CellPath(int x, int z) {
+    string dir = directory.empty() ? Setting::settingDir + "\\cells" : directory;
+    return dir + "\\cell_" + std::to_string(x) + "_" + std::to_string(z) + ".json";
+}
+
+static vec3 JsonVec3(const json& j, const char* key, vec3 fallback) {
+    if (!j.contains(key)) return fallback;
+    const json& v = j.at(key);
+    return vec3(v.at(0).get<float>(), v.at(1).get<float>(), v.at(2).get<float>());
+}
+
+string WorldStreamer::ModelPath(const string& model) {
+    return workDir.substr(0, workDir.find_last_of('\\')) + "\\" + model; // 和ModelRender::Start相同的路径（AssetCache的键）
+}
+
+// 没有创建的对象的后台导入结果不再需要（其他单元再用到时重新导入）
+void WorldStreamer::DropImports(const Cell& cell) {
+    for (size_t i = cell.next; i < cell.data.size(); i++)
+        if (!cell.data[i].model.empty()) AssetCache::DropImport(ModelPath(cell.data[i].model));
+}
+
+// 后台线程：读取并解析单元文件，导入引用的模型并解码其纹理（主线程创建对象时只做数据转换和上传）
+// 格式错误的单元记录日志后按空单元处理（异常不能逃出线程，否则进程终止）
+void WorldStreamer::LoaderLoop() {
+    for (;;) {
+        std::pair<long long, string> request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [] { return stopping || !requests.empty(); });
+            if (stopping) return;
+            request = requests.front();
+            requests.pop_front();
+        }
+        Parsed parsed{ request.first, {}, 0 };
+        std::vector<string> models;
+        VfsFile file;
+        try {
+            if (Vfs::Read(request.second, file)) {
+                json j = json::parse(file.data, file.data + file.size, nullptr, false);
+                if (!j.is_discarded() && j.contains("objects")) {
+                    std::unordered_map<string, bool> seen;
+                    for (auto& o : j.at("objects")) {
+                        CellObject object;
+                        object.name = o.value("name", string("Object"));
+                        object.type = o.value("type", 0);
+                        object.position = JsonVec3(o, "position", vec3(0));
+                        object.rotation = JsonVec3(o, "rotation", vec3(0));
+                        object.scale = JsonVec3(o, "scale", vec3(1));
+                        object.model = o.value("model", string());
+                        object.shader = o.value("shader", string());
+                        object.animation = o.value("animation", string());
+                        if (!object.model.empty() && !seen[object.model]) {
+                            seen[object.model] = true;
+                            models.push_back(ModelPath(object.model));
+                        }
+                        parsed.data.push_back(std::move(object));
+                    }
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cout << "WorldStreamer: bad cell " << request.second << " (" << e.what() << ")" << std::endl;
+            parsed.data.clear();
+            models.clear();
+        }
+        for (auto& path : models) {
+            parsed.bytes += Vfs::Size(path);
+            AssetCache::Import(path);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(parsed));
+    }
+}
+
+void WorldStreamer::Request(Cell & cell) {
+    cell.state = State::Requested;
+    std::lock_guard<std::mutex> lock(mutex);
+    requests.emplace_back(Key(cell.x, cell.z), CellPath(cell.x, cell.z));
+}
+
+// 创建单元中的下一个对象（先不启动ModelRender，设置好模型和着色器名再Start）
+bool WorldStreamer::Instantiate(Cell & cell) {
+    if (cell.next >= cell.data.size()) return true;
+    const CellObject& o = cell.data[cell.next++];
+    GameObject* object = new GameObject(o.name, (GameObject::Type)o.type);
+    Transform* transform = object->transform();
+    transform->position = o.position;
+    transform->rotation = o.rotation;
+    transform->scale = o.scale;
+    if (!o.model.empty()) {
+        ModelRender* render = object->AddComponent<ModelRender>();
+        render->modelName = o.model;
+        if (!o.shader.empty()) render->shaderName = o.shader;
+        render->Start();
+        if (!o.animation.empty()) {
+            Animator* animator = object->AddComponent<Animator>();
+            if (o.animation != "*") animator->clipName = o.animation;
+            animator->time = (cell.next % 16) * 0.13f; // 同一单元的角色错开起始时间
+        }
+    }
+    cell.objects.emplace_back(object, std::prev(Setting::gameObjects->end())); // 构造时加到了列表末尾
+    return cell.next >= cell.data.size();
+}
+
+bool WorldStreamer::Destroy(Cell & cell) {
+    if (cell.objects.empty()) return true;
+    auto entry = cell.objects.back();
+    cell.objects.pop_back();
+    Setting::gameObjects->erase(entry.second);
+    delete entry.first; // 组件析构时归还共享模型和着色器，最后一个引用释放资源
+    return cell.objects.empty();
+}
+
+void WorldStreamer::Update() {
+    if (!enable || !Setting::MainCamera) return;
+    if (!loader.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return; // 已经关闭
+        }
+        loader = std::thread(LoaderLoop);
+        std::atexit(Shutdown); // 静态的std::thread析构时不能仍可join
+    }
+    vec3 eye = Setting::MainCamera->gameObject->transform()->position;
+    int cx = (int)std::floor(eye.x / cellSize), cz = (int)std::floor(eye.z / cellSize);
+    auto ring = [&](const Cell& c) { return std::max(std::abs(c.x - cx), std::abs(c.z - cz)); };
+
+    // 收取后台解析结果（期间已经离开范围的单元直接丢弃）
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& parsed : results) {
+            auto found = cells.find(parsed.key);
+            if (found == cells.end() || found->second.state != State::Requested) {
+                Cell discarded;
+                discarded.data = std::move(parsed.data);
+                DropImports(discarded);
+                continue;
+            }
+            found->second.data = std::move(parsed.data);
+            found->second.bytes = parsed.bytes;
+            found->second.state = State::Parsed;
+        }
+        results.clear();
+    }
+
+    // 加载半径内的新单元按圈由近到远请求
+    std::vector<std::pair<int, long long>> wanted;
+    for (int z = cz - loadRadius; z <= cz + loadRadius; z++) {
+        for (int x = cx - loadRadius; x <= cx + loadRadius; x++) {
+            Cell& cell = cells[Key(x, z)];
+            cell.x = x;
+            cell.z = z;
+            if (cell.state == State::Unloaded) wanted.emplace_back(ring(cell), Key(x, z));
+        }
+    }
+    std::sort(wanted.begin(), wanted.end());
+    for (auto& w : wanted) Request(cells[w.second]);
+    if (!wanted.empty()) wake.notify_one();
+
+    // 超出卸载半径（加载半径 + 滞后圈数）的单元：还没创建的直接取消，已创建的逐帧销毁
+    for (auto it = cells.begin(); it != cells.end();) {
+        Cell& cell = it->second;
+        if (ring(cell) > loadRadius + hysteresis) {
+            if (cell.state == State::Instantiating || cell.state == State::Loaded) {
+                if (cell.state == State::Instantiating) {
+                    pendingBytes -= cell.bytes;
+                    DropImports(cell);
+                }
+                cell.state = State::Unloading;
+            } else if (cell.state == State::Requested || cell.state == State::Parsed || cell.state == State::Unloaded) {
+                if (cell.state == State::Parsed) DropImports(cell);
+                it = cells.erase(it); // 后台结果回来时找不到单元，自动丢弃
+                continue;
+            }
+        }
+        ++it;
+    }
+
+    // 解析完成的单元按圈开始创建；相机所在单元和相邻一圈总是允许，其余受内存预算限制
+    std::vector<std::pair<int, Cell*>> ready;
+    for (auto& entry : cells)
+        if (entry.second.state == State::Parsed) ready.emplace_back(ring(entry.second), &entry.second);
+    std::sort(ready.begin(), ready.end(), [](const std::pair<int, Cell*>& a, const std::pair<int, Cell*>& b) { return a.first < b.first; });
+    for (auto& r : ready) {
+        if (r.first > 1 && AssetCache::ResidentBytes() + pendingBytes + r.second->bytes > memoryBudget) break;
+        r.second->state = State::Instantiating;
+        pendingBytes += r.second->bytes;
+    }
+
+    // 分帧执行：先卸载（释放预算），再由近到远创建，受对象数和时间预算限制
+    auto start = std::chrono::steady_clock::now();
+    auto overBudget = [&](int done) {
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return done >= objectsPerFrame || ms >= msPerFrame;
+    };
+    int done = 0;
+    for (auto it = cells.begin(); it != cells.end() && !overBudget(done);) {
+        Cell& cell = it->second;
+        if (cell.state != State::Unloading) { ++it; continue; }
+        while (!overBudget(done)) {
+            done++;
+            if (Destroy(cell)) break;
+        }
+        if (cell.objects.empty()) { it = cells.erase(it); continue; }
+        ++it;
+    }
+    std::vector<std::pair<int, Cell*>> building;
+    for (auto& entry : cells)
+        if (entry.second.state == State::Instantiating) building.emplace_back(ring(entry.second), &entry.second);
+    std::sort(building.begin(), building.end(), [](const std::pair<int, Cell*>& a, const std::pair<int, Cell*>& b) { return a.first < b.first; });
+    for (auto& b : building) {
+        Cell& cell = *b.second;
+        while (!overBudget(done)) {
+            done++;
+            if (Instantiate(cell)) {
+                cell.state = State::Loaded;
+                pendingBytes -= cell.bytes; // 模型已计入AssetCache::ResidentBytes
+                cell.data.clear();
+                cell.data.shrink_to_fit();
+                break;
+            }
+        }
+        if (overBudget(done)) break;
+    }
+}
+
+// ImGui 调试界面（显示各状态的单元数和内存预算）
+void WorldStreamer::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        requests.clear();
+    }
+    wake.notify_one();
+    if (loader.joinable()) loader.join();
+}
+
+void WorldStreamer::OnGUI() {
+    if (ImGui::TreeNode("WorldStreamer")) {
+        ImGui::Checkbox("Enable", &enable);
+        ImGui::DragFloat("CellSize", &cellSize, 1, 8, 1024);
+        ImGui::DragInt("LoadRadius", &loadRadius, 0.1f, 0, 16);
+        ImGui::DragInt("Hysteresis", &hysteresis, 0.1f, 0, 8);
+        ImGui::DragInt("ObjectsPerFrame", &objectsPerFrame, 0.5f, 1, 256);
+        ImGui::DragFloat("MsPerFrame", &msPerFrame, 0.1f, 0.1f, 16);
+        int counts[6] = { 0 };
+        for (auto& entry : cells) counts[(int)entry.second.state]++;
+        ImGui::Text("requested: %d  parsed: %d  building: %d", counts[1], counts[2], counts[3]);
+        ImGui::Text("loaded: %d  unloading: %d", counts[4], counts[5]);
+        ImGui::Text("models: %d  shaders: %d", AssetCache::ModelCount(), AssetCache::ShaderCount());
+        ImGui::Text("resident: %.1f / %.1f MB", AssetCache::ResidentBytes() / 1048576.0, memoryBudget / 1048576.0);
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+#pragma endregion
+
+
+// ====================== MeshletCulling 网格簇剔除 ======================
+#pragma region MeshletCulling
+
+// 导入时把网格切成小簇（最多64个顶点、124个三角形），每簇记录包围球和法线锥；
+// 绘制时在CPU上按簇做视锥和背面锥剔除（SIMD批量，簇多时并行），只提交存活簇的索引区间。
+// 簇是索引缓冲中连续的三角形区间，相邻的存活簇合并后用一次glMultiDrawElements提交，不需要重排或复制索引
+enum MeshletBound { MB_CX, MB_CY, MB_CZ, MB_R, MB_AX, MB_AY, MB_AZ, MB_CUTOFF, MB_COUNT };
+
+// 批量内核：处理[begin, end)（begin按8对齐，数组长度已按8补齐），visible[i]写0或1
+typedef void(*MeshletKernel)(const float* const* bounds, const vec4* planes, const vec4& camera, unsigned char* visible, int begin, int end);
+
+class MeshletCulling {
+public:
+    struct MeshletSet {
+        std::vector<unsigned int> first;   // 每簇在索引缓冲中的起始索引
+        std::vector<GLsizei> count;        // 每簇的索引数
+        std::vector<float> bounds[MB_COUNT]; // 包围球和法线锥（数组结构体，长度按8补齐）
+        int size = 0;
+    };
+    static void Build(GLuint vao, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices); // Mesh构造时调用
+    static void Remove(GLuint vao);
+    // 设置当前绘制的物体和视图（之后的Draw按它剔除），End之后恢复整网格绘制（阴影等其他通道不受影响）
+    static void Begin(const mat4& model, const mat4& view, const mat4& proj);
+    static void End();
+    static void Draw(GLuint vao, GLsizei indexCount); // 调用前已绑定VAO
+    static void EndFrame();                            // 每帧结束时统计
+    static void OnGUI();
+    static bool enabled;
+    static bool coneCulling;                           // 背面锥剔除（默认关闭：场景没有开启GL_CULL_FACE，开放网格的背面也要显示）
+    static const int maxVertices = 64, maxTriangles = 124;
+    static int minMeshlets;                            // 簇数少于此值的网格直接整体绘制
+private:
+    static void AddMeshlet(MeshletSet& set, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int first, unsigned int end);
+    static std::unordered_map<GLuint, MeshletSet> sets; // 按VAO索引（Mesh按值存放在Model中，VAO在拷贝间不变）
+    static MeshletKernel kernel;
+    static bool active;
+    static vec4 planes[6];   // 物体空间的视锥平面（已归一化）
+    static vec4 camera;      // 物体空间的相机位置，w为是否做锥剔除（正交投影时关闭）
+    static long long trianglesTotal, trianglesDrawn, meshletsTotal, meshletsDrawn; // 本帧累计
+    static long long shownTotal, shownDrawn, shownMeshlets, shownVisible;           // 上一帧（调试界面显示）
+};
+
+// 静态成员初始化
+bool MeshletCulling::enabled = true;
+bool MeshletCulling::coneCulling = false;
+int MeshletCulling::minMeshlets = 8;
+std::unordered_map<GLuint, MeshletCulling::MeshletSet> MeshletCulling::sets;
+MeshletKernel MeshletCulling::kernel = nullptr;
+bool MeshletCulling::active = false;
+vec4 MeshletCulling::planes[6];
+vec4 MeshletCulling::camera;
+long long MeshletCulling::trianglesTotal = 0, MeshletCulling::trianglesDrawn = 0, MeshletCulling::meshletsTotal = 0, MeshletCulling::meshletsDrawn = 0;
+long long MeshletCulling::shownTotal = 0, MeshletCulling::shownDrawn = 0, MeshletCulling::shownMeshlets = 0, MeshletCulling::shownVisible = 0;
+
+// ---- SSE2（4路） ----
+// 视锥：包围球在任一平面外侧则剔除；背面锥：dot(c - eye, axis) >= cutoff * |c - eye| + r 时所有三角形都背对相机
+static void CullMeshletsSSE(const float* const* b, const vec4* planes, const vec4& camera, unsigned char* visible, int begin, int end) {
+    for (int i = begin; i < end; i += 4) {
+        __m128 cx = _mm_loadu_ps(b[MB_CX] + i), cy = _mm_loadu_ps(b[MB_CY] + i), cz = _mm_loadu_ps(b[MB_CZ] + i);
+        __m128 r = _mm_loadu_ps(b[MB_R] + i);
+        __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), cx), _mm_mul_ps(_mm_set1_ps(planes[p].y), cy)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), cz), _mm_set1_ps(planes[p].w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+        }
+        if (camera.w != 0) {
+            __m128 dx = _mm_sub_ps(cx, _mm_set1_ps(camera.x)), dy = _mm_sub_ps(cy, _mm_set1_ps(camera.y)), dz = _mm_sub_ps(cz, _mm_set1_ps(camera.z));
+            __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+            __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(b[MB_AX] + i)), _mm_mul_ps(dy, _mm_loadu_ps(b[MB_AY] + i))),
+                _mm_mul_ps(dz, _mm_loadu_ps(b[MB_AZ] + i)));
+            __m128 back = _mm_cmpge_ps(along, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(b[MB_CUTOFF] + i), len), r));
+            inside = _mm_andnot_ps(back, inside);
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; k++) visible[i + k] = (unsigned char)(mask >> k & 1);
+    }
+}
+
+// ---- AVX2（8路） ----
+TARGET_AVX2 static void CullMeshletsAVX2(const float* const* b, const vec4* planes, const vec4& camera, unsigned char* visible, int begin, int end) {
+    for (int i = begin; i < end; i += 8) {
+        __m256 cx = _mm256_loadu_ps(b[MB_CX] + i), cy = _mm256_loadu_ps(b[MB_CY] + i), cz = _mm256_loadu_ps(b[MB_CZ] + i);
+        __m256 r = _mm256_loadu_ps(b[MB_R] + i);
+        __m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), r);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 d = _mm256_fmadd_ps(_mm256_set1_ps(planes[p].x), cx,
+                _mm256_fmadd_ps(_mm256_set1_ps(planes[p].y), cy, _mm256_fmadd_ps(_mm256_set1_ps(planes[p].z), cz, _mm256_set1_ps(planes[p].w))));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+        }
+        if (camera.w != 0) {
+            __m256 dx = _mm256_sub_ps(cx, _mm256_set1_ps(camera.x)), dy = _mm256_sub_ps(cy, _mm256_set1_ps(camera.y)), dz = _mm256_sub_ps(cz, _mm256_set1_ps(camera.z));
+            __m256 len = _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz))));
+            __m256 along = _mm256_fmadd_ps(dx, _mm256_loadu_ps(b[MB_AX] + i),
+                _mm256_fmadd_ps(dy, _mm256_loadu_ps(b[MB_AY] + i), _mm256_mul_ps(dz, _mm256_loadu_ps(b[MB_AZ] + i))));
+            __m256 back = _mm256_cmp_ps(along, _mm256_fmadd_ps(_mm256_loadu_ps(b[MB_CUTOFF] + i), len, r), _CMP_GE_OQ);
+            inside = _mm256_andnot_ps(back, inside);
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int k = 0; k < 8; k++) visible[i + k] = (unsigned char)(mask >> k & 1);
+    }
+}
+
+// 追加一簇（三角形区间[first, end)）：包围球取包围盒中心，法线锥取三角形法线的平均方向和最大偏角
+void MeshletCulling::AddMeshlet(MeshletSet & set, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int first, unsigned int end) {
+    vec3 mn(FLT_MAX), mx(-FLT_MAX), normalSum(0);
+    for (unsigned int i = first; i < end; i++) {
+        mn = min(mn, vertices[indices[i]].position);
+        mx = max(mx, vertices[indices[i]].position);
+    }
+    vec3 center = (mn + mx) * 0.5f;
+    float radius = 0;
+    for (unsigned int i = first; i < end; i++) radius = std::max(radius, length(vertices[indices[i]].position - center));
+    for (unsigned int t = first; t < end; t += 3) {
+        const vec3& p0 = vertices[indices[t]].position;
+        vec3 n = cross(vertices[indices[t + 1]].position - p0, vertices[indices[t + 2]].position - p0);
+        float l = length(n);
+        if (l > 0) normalSum += n / l; // 退化三角形没有朝向，不参与
+    }
+    vec3 axis(0, 0, 1);
+    float cutoff = 1; // 1表示从不剔除（dot(d, axis) <= |d| < |d| + r）
+    if (length(normalSum) > 0) {
+        axis = normalize(normalSum);
+        float minDot = 1;
+        for (unsigned int t = first; t < end; t += 3) {
+            const vec3& p0 = vertices[indices[t]].position;
+            vec3 n = cross(vertices[indices[t + 1]].position - p0, vertices[indices[t + 2]].position - p0);
+            float l = length(n);
+            if (l > 0) minDot = std::min(minDot, dot(n / l, axis));
+        }
+        if (minDot > 0.1f) cutoff = std::sqrt(1 - minDot * minDot); // 偏角接近或超过90度的锥剔除不了什么，直接关闭
+    }
+    float values[MB_COUNT] = { center.x, center.y, center.z, radius, axis.x, axis.y, axis.z, cutoff };
+    for (int b = 0; b < MB_COUNT; b++) set.bounds[b].push_back(values[b]);
+    set.first.push_back(first);
+    set.count.push_back((GLsizei)(end - first));
+    set.size++;
+}
+
+// 按索引顺序贪心切簇，顶点或三角形数超出上限时开新簇
+// （AssetCache::importFlags合并了相同顶点并按顶点缓存重排，索引顺序有较好的空间局部性；
+// 没有合并的网格每个三角形独占顶点，约21个三角形就达到顶点上限）
+void MeshletCulling::Build(GLuint vao, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+    if (indices.size() < (size_t)minMeshlets * 3) return; // 三角形数少于簇数下限，不可能切出足够的簇
+    MeshletSet set;
+    std::vector<int> stamp(vertices.size(), -1); // 顶点最后被哪一簇使用
+    int meshlet = 0, vertexCount = 0, triangleCount = 0;
+    unsigned int first = 0;
+    for (unsigned int t = 0; t + 2 < indices.size(); t += 3) {
+        int fresh = 0;
+        for (int k = 0; k < 3; k++) fresh += stamp[indices[t + k]] != meshlet;
+        if (vertexCount + fresh > maxVertices || triangleCount + 1 > maxTriangles) {
+            AddMeshlet(set, vertices, indices, first, t);
+            first = t;
+            meshlet++;
+            vertexCount = triangleCount = 0;
+            fresh = 3;
+        }
+        for (int k = 0; k < 3; k++) stamp[indices[t + k]] = meshlet;
+        vertexCount += fresh;
+        triangleCount++;
+    }
+    unsigned int end = (unsigned int)(indices.size() / 3 * 3);
+    if (end > first) AddMeshlet(set, vertices, indices, first, end);
+    if (set.size < minMeshlets) return; // 簇太少，整体绘制更划算（按实际切出的簇数判断）
+    size_t padded = (set.size + 7) & ~7;
+    for (auto& b : set.bounds) b.resize(padded, 0.0f);
+    sets[vao] = std::move(set);
+}
+
+void MeshletCulling::Remove(GLuint vao) {
+    sets.erase(vao);
+}
+
+// 视锥平面和相机位置都变换到物体空间：簇的包围数据不需要逐帧变换，非均匀缩放下背面判断也保持正确
+void MeshletCulling::Begin(const mat4 & model, const mat4 & view, const mat4 & proj) {
+    if (!enabled) return;
+    mat4 m = transpose(proj * view * model);
+    vec4 p[6] = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2] };
+    for (int i = 0; i < 6; i++) {
+        float l = length(vec3(p[i]));
+        planes[i] = l > 0 ? p[i] / l : vec4(0, 0, 0, 1);
+    }
+    bool perspective = proj[3][3] == 0; // 正交投影没有单一的相机位置
+    camera = vec4(vec3(inverse(view * model)[3]), coneCulling && perspective ? 1.0f : 0.0f);
+    active = true;
+}
+
+void MeshletCulling::End() {
+    active = false;
+}
+
+// 剔除并提交存活的簇（不在Begin/End之间或没有簇的网格整体绘制）
+void MeshletCulling::Draw(GLuint vao, GLsizei indexCount) {
+    auto it = active ? sets.find(vao) : sets.end();
+    if (it == sets.end()) {
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+        return;
+    }
+    if (!kernel) kernel = CpuHasAVX2() ? CullMeshletsAVX2 : CullMeshletsSSE;
+    const MeshletSet& set = it->second;
+    const float* bounds[MB_COUNT];
+    for (int b = 0; b < MB_COUNT; b++) bounds[b] = set.bounds[b].data();
+    int padded = (int)set.bounds[0].size();
+    unsigned char* visible = FrameArena::Allocate<unsigned char>(padded);
+    // 按8个簇一组分配，大网格（上千个簇）分给多个线程
+    Jobs::ParallelFor(padded / 8, 64, [&](int begin, int end) {
+        kernel(bounds, planes, camera, visible, begin * 8, end * 8);
+    });
+
+    // 压缩：相邻的存活簇合并成一个索引区间
+    GLsizei* counts = FrameArena::Allocate<GLsizei>(set.size);
+    const void** offsets = FrameArena::Allocate<const void*>(set.size);
+    int ranges = 0;
+    unsigned int rangeEnd = UINT_MAX;
+    long long drawn = 0, survivors = 0;
+    for (int i = 0; i < set.size; i++) {
+        if (!visible[i]) continue;
+        survivors++;
+        drawn += set.count[i];
+        if (set.first[i] == rangeEnd) {
+            counts[ranges - 1] += set.count[i];
+        } else {
+            counts[ranges] = set.count[i];
+            offsets[ranges] = (const void*)((size_t)set.first[i] * sizeof(unsigned int));
+            ranges++;
+        }
+        rangeEnd = set.first[i] + set.count[i];
+    }
+    if (ranges == 1) glDrawElements(GL_TRIANGLES, counts[0], GL_UNSIGNED_INT, offsets[0]);
+    else if (ranges > 1) glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, ranges);
+    trianglesTotal += indexCount / 3;
+    trianglesDrawn += drawn / 3;
+    meshletsTotal += set.size;
+    meshletsDrawn += survivors;
+}
+
+void MeshletCulling::EndFrame() {
+    shownTotal = trianglesTotal;
+    shownDrawn = trianglesDrawn;
+    shownMeshlets = meshletsTotal;
+    shownVisible = meshletsDrawn;
+    trianglesTotal = trianglesDrawn = meshletsTotal = meshletsDrawn = 0;
+}
+
+// ImGui 调试界面（显示上一帧经过簇剔除的三角形数）
+void MeshletCulling::OnGUI() {
+    if (ImGui::TreeNode("MeshletCulling")) {
+        ImGui::Checkbox("Enable", &enabled);
+        ImGui::Checkbox("ConeCulling", &coneCulling);
+        ImGui::Text("meshes: %d  kernel: %s", (int)sets.size(), kernel == CullMeshletsAVX2 ? "AVX2" : "SSE2");
+        ImGui::Text("meshlets: %lld / %lld", shownVisible, shownMeshlets);
+        ImGui::Text("triangles: %lld / %lld (%.1f%%)", shownDrawn, shownTotal, shownTotal ? 100.0 * shownDrawn / shownTotal : 0.0);
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+#pragma endregion
+
+
+// ====================== RenderGraph 渲染图 ======================
+#pragma region RenderGraph
+
+// 渲染图（每帧重新声明：通道声明读写的资源，编译时按依赖剔除无用通道、计算资源生命周期，
+// 生命周期不重叠且格式尺寸相同的临时渲染目标共用同一张纹理；首次写入临时资源的通道自动清除）
+// 只管理每帧重建的临时目标：阴影图集和遮挡深度跨帧保留缓存（静态阴影、上一帧的Hi-Z），
+// 由ShadowSystem/OcclusionCulling在主相机RealUpdate中自行渲染，不进入渲染图
+class RenderGraph {
+public:
+    struct Resource {
+        string name;
+        int width, height;
+        GLenum format;              // GL_RGBA8 / GL_RGBA16F / GL_DEPTH_COMPONENT24
+        bool imported = false;      // 外部帧缓冲（窗口或离屏FBO），写它的通道不会被剔除
+        GLuint framebuffer = 0;     // 导入资源的帧缓冲
+        int first = -1, last = -1;  // 生命周期（通道下标）
+        int physical = -1;          // 分配到的纹理
+        int producer = -1;          // 最后一个写它的通道（编译时使用）
+    };
+    struct Pass {
+        string name;
+        std::vector<int> reads, writes;
+        std::function<void()> execute;
+        std::vector<int> clears;    // 编译时插入：首次写入的临时资源
+        bool culled = false;
+    };
+    static void Reset();                                   // 每帧开始声明前调用
+    static int Create(const string& name, int width, int height, GLenum format);
+    static int ImportFramebuffer(const string& name, GLuint framebuffer, int width, int height);
+    static void AddPass(const string& name, const std::vector<int>& reads, const std::vector<int>& writes, std::function<void()> execute);
+    static void Compile();
+    static void Execute();
+    static GLuint Texture(int resource);                  // 执行期间取资源对应的纹理
+    static GLuint Framebuffer(const std::vector<int>& attachments);
+    static string Dump();                                  // 编译结果（通道、生命周期、别名、节省的内存）
+    static void OnGUI();
+    static bool alias;                                     // 是否开启临时资源别名
+    static size_t requestedBytes, allocatedBytes;          // 不共用时需要的显存 / 实际分配
+private:
+    struct Physical {
+        int width, height;
+        GLenum format;
+        GLuint texture;
+        int freeAfter;    // 本帧中这之后的通道可以复用（-1为本帧未使用）
+        unsigned int lastFrame;
+    };
+    static size_t Bytes(int width, int height, GLenum format);
+    static bool IsDepth(GLenum format) { return format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F; }
+    static std::vector<Resource> resources;
+    static std::vector<Pass> passes;
+    static std::vector<Physical> pool;
+    static std::unordered_map<string, GLuint> framebuffers;   // 附件组合 -> FBO
+    static unsigned int frame;
+    static string lastDump;
+    static bool dumpToConsole;
+};
+
+// 静态成员初始化
+bool RenderGraph::alias = true;
+size_t RenderGraph::requestedBytes = 0;
+size_t RenderGraph::allocatedBytes = 0;
+std::vector<RenderGraph::Resource> RenderGraph::resources;
+std::vector<RenderGraph::Pass> RenderGraph::passes;
+std::vector<RenderGraph::Physical> RenderGraph::pool;
+std::unordered_map<string, GLuint> RenderGraph::framebuffers;
+unsigned int RenderGraph::frame = 0;
+string RenderGraph::lastDump;
+bool RenderGraph::dumpToConsole = false;
+
+size_t RenderGraph::Bytes(int width, int height, GLenum format) {
+    size_t texel = format == GL_RGBA16F ? 8 : 4; // 24位深度按4字节存储
+    return (size_t)width * height * texel;
+}
+
+void RenderGraph::Reset() {
+    resources.clear();
+    passes.clear();
+    frame++;
+}
+
+int RenderGraph::Create(const string & name, int width, int height, GLenum format) {
+    Resource r;
+    r.name = name;
+    r.width = std::max(width, 1);
+    r.height = std::max(height, 1);
+    r.format = format;
+    resources.push_back(r);
+    return (int)resources.size() - 1;
+}
+
+int RenderGraph::ImportFramebuffer(const string & name, GLuint framebuffer, int width, int height) {
+    int id = Create(name, width, height, GL_RGBA8);
+    resources[id].imported = true;
+    resources[id].framebuffer = framebuffer;
+    return id;
+}
+
+void RenderGraph::AddPass(const string & name, const std::vector<int>& reads, const std::vector<int>& writes, std::function<void()> execute) {
+    Pass p;
+    p.name = name;
+    p.reads = reads;
+    p.writes = writes;
+    p.execute = std::move(execute);
+    passes.push_back(std::move(p));
+}
+
+void RenderGraph::Compile() {
+    // 1. 依赖：每个读取连到之前最后写入该资源的通道（声明顺序即执行顺序，自然是拓扑序）
+    std::vector<std::vector<int>> dependencies(passes.size());
+    for (auto& r : resources) r.producer = -1;
+    for (int p = 0; p < (int)passes.size(); p++) {
+        for (int r : passes[p].reads)
+            if (resources[r].producer >= 0) dependencies[p].push_back(resources[r].producer);
+        for (int r : passes[p].writes) resources[r].producer = p;
+    }
+
+    // 2. 剔除：从写导入资源的通道出发反向标记，没被标记的通道输出无人使用
+    for (auto& p : passes) p.culled = true;
+    std::vector<int> stack;
+    for (int p = 0; p < (int)passes.size(); p++)
+        for (int r : passes[p].writes)
+            if (resources[r].imported) { stack.push_back(p); break; }
+    while (!stack.empty()) {
+        int p = stack.back();
+        stack.pop_back();
+        if (!passes[p].culled) continue;
+        passes[p].culled = false;
+        for (int d : dependencies[p]) stack.push_back(d);
+    }
+
+    // 3. 生命周期与清除：只统计保留的通道；首次使用是写入的临时资源需要清除
+    for (auto& r : resources) {
+        r.first = r.last = -1;
+        r.physical = -1;
+    }
+    for (int p = 0; p < (int)passes.size(); p++) {
+        Pass& pass = passes[p];
+        pass.clears.clear();
+        if (pass.culled) continue;
+        for (int r : pass.reads) {
+            if (resources[r].first < 0) resources[r].first = p;
+            resources[r].last = p;
+        }
+        for (int r : pass.writes) {
+            if (resources[r].first < 0) {
+                resources[r].first = p;
+                if (!resources[r].imported) pass.clears.push_back(r);
+            }
+            resources[r].last = p;
+        }
+    }
+
+    // 4. 别名：按通道顺序分配，资源最后一次使用之后它的纹理回到池中，同格式同尺寸的后续资源复用
+    for (auto& phys : pool) phys.freeAfter = -1;
+    std::vector<bool> inUse(pool.size(), false);
+    requestedBytes = allocatedBytes = 0;
+    for (int p = 0; p < (int)passes.size(); p++) {
+        for (int id = 0; id < (int)resources.size(); id++) {
+            Resource& r = resources[id];
+            if (r.imported || r.first != p) continue;
+            requestedBytes += Bytes(r.width, r.height, r.format);
+            int chosen = -1;
+            for (int i = 0; i < (int)pool.size() && chosen < 0; i++) {
+                const Physical& phys = pool[i];
+                bool reusable = !inUse[i] && (phys.freeAfter < 0 || (alias && phys.freeAfter < p));
+                if (reusable && phys.width == r.width && phys.height == r.height && phys.format == r.format) chosen = i;
+            }
+            if (chosen < 0) {
+                Physical phys{ r.width, r.height, r.format, 0, -1, frame };
+                glGenTextures(1, &phys.texture);
+                glBindTexture(GL_TEXTURE_2D, phys.texture);
+                GLenum format = IsDepth(r.format) ? GL_DEPTH_COMPONENT : GL_RGBA;
+                GLenum type = IsDepth(r.format) ? GL_UNSIGNED_INT : (r.format == GL_RGBA16F ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE);
+                glTexImage2D(GL_TEXTURE_2D, 0, r.format, r.width, r.height, 0, format, type, nullptr);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                pool.push_back(phys);
+                inUse.push_back(false);
+                chosen = (int)pool.size() - 1;
+            }
+            if (pool[chosen].freeAfter < 0) allocatedBytes += Bytes(r.width, r.height, r.format); // 本帧第一次使用这张纹理
+            r.physical = chosen;
+            inUse[chosen] = true;
+            pool[chosen].lastFrame = frame;
+            pool[chosen].freeAfter = r.last;
+        }
+        for (auto& r : resources)
+            if (!r.imported && r.physical >= 0 && r.last == p) inUse[r.physical] = false;
+    }
+
+    // 连续多帧没用到的纹理释放（视口尺寸变化后旧尺寸的纹理不再匹配）
+    for (int i = (int)pool.size() - 1; i >= 0; i--) {
+        if (frame - pool[i].lastFrame < 120) continue;
+        for (auto it = framebuffers.begin(); it != framebuffers.end();) { // 引用它的FBO一并删除
+            if (it->first.find("," + std::to_string(pool[i].texture) + ",") != string::npos) {
+                glDeleteFramebuffers(1, &it->second);
+                it = framebuffers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        glDeleteTextures(1, &pool[i].texture);
+        pool.erase(pool.begin() + i);
+        for (auto& r : resources)
+            if (r.physical > i) r.physical--;
+    }
+
+    if (dumpToConsole) {
+        std::cout << Dump() << std::endl;
+        dumpToConsole = false;
+    }
+}
+
+GLuint RenderGraph::Texture(int resource) {
+    int physical = resources[resource].physical;
+    return physical >= 0 ? pool[physical].texture : 0;
+}
 
-// 初始化逻辑（虚函数，派生类可重写）
-void MonoBehavior::Start() {}
+// 附件组合对应的FBO（缓存复用；颜色按声明顺序依次绑定，深度格式绑定为深度附件）
+GLuint RenderGraph::Framebuffer(const std::vector<int>& attachments) {
+    for (int r : attachments)
+        if (resources[r].imported) return resources[r].framebuffer;
+    string key = ",";
+    for (int r : attachments) key += std::to_string(Texture(r)) + ",";
+    auto found = framebuffers.find(key);
+    if (found != framebuffers.end()) return found->second;
+
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    std::vector<GLenum> drawBuffers;
+    for (int r : attachments) {
+        if (IsDepth(resources[r].format)) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, Texture(r), 0);
+        } else {
+            GLenum attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, Texture(r), 0);
+            drawBuffers.push_back(attachment);
+        }
+    }
+    if (drawBuffers.empty()) glDrawBuffer(GL_NONE);
+    else glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "RenderGraph: incomplete framebuffer " << key << std::endl;
+    framebuffers[key] = fbo;
+    return fbo;
+}
 
-// 物理更新（虚函数，用于固定时间步逻辑）
-void MonoBehavior::RealUpdate() {}
+// 按顺序执行保留的通道：绑定写入目标（读取的深度也作为深度附件用于测试），执行插入的清除，再调用通道
+void RenderGraph::Execute() {
+    for (auto& pass : passes) {
+        if (pass.culled) continue;
+        std::vector<int> attachments = pass.writes;
+        for (int r : pass.reads)
+            if (IsDepth(resources[r].format) && std::find(attachments.begin(), attachments.end(), r) == attachments.end())
+                attachments.push_back(r);
+        if (!attachments.empty()) {
+            const Resource& target = resources[attachments[0]];
+            glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer(attachments));
+            glViewport(0, 0, target.width, target.height);
+        }
+        if (!pass.clears.empty()) {
+            GLbitfield mask = 0;
+            for (int r : pass.clears) mask |= IsDepth(resources[r].format) ? GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT;
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthMask(GL_TRUE);
+            glClearColor(0, 0, 0, 1);
+            glClearDepth(1);
+            glClear(mask);
+        }
+        pass.execute();
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, Headless::framebuffer); // 回到场景目标（ImGui等后续绘制）
+}
 
-// 每帧更新（虚函数，随帧率调用）
-void MonoBehavior::Update() {}
+string RenderGraph::Dump() {
+    std::ostringstream out;
+    out << "RenderGraph frame " << frame << "\n";
+    for (int p = 0; p < (int)passes.size(); p++) {
+        const Pass& pass = passes[p];
+        out << "  [" << p << "] " << pass.name << (pass.culled ? "  (culled)" : "") << "\n";
+        for (int r : pass.clears) out << "      clear " << resources[r].name << "\n";
+        for (int r : pass.reads) out << "      read  " << resources[r].name << "\n";
+        for (int r : pass.writes) out << "      write " << resources[r].name << "\n";
+    }
+    out << "  resources:\n";
+    for (auto& r : resources) {
+        out << "    " << r.name << "  " << r.width << "x" << r.height;
+        if (r.imported) out << "  imported";
+        else if (r.physical < 0) out << "  unused";
+        else out << "  passes " << r.first << "-" << r.last << "  texture #" << r.physical
+                 << "  " << Bytes(r.width, r.height, r.format) / 1024 << " KB";
+        out << "\n";
+    }
+    out << "  transient memory: " << requestedBytes / 1024 << " KB requested, " << allocatedBytes / 1024
+        << " KB allocated, " << (requestedBytes - allocatedBytes) / 1024 << " KB saved by aliasing\n";
+    lastDump = out.str();
+    return lastDump;
+}
 
-// ImGui 调试界面（虚函数，显示启用状态复选框）
-void MonoBehavior::OnGUI() const {
-    ImGui::Checkbox("Enable", (bool*)&enable); // 显示启用状态切换复选框
+// ImGui 调试界面（显示编译结果和别名节省的显存）
+void RenderGraph::OnGUI() {
+    if (ImGui::TreeNode("RenderGraph")) {
+        ImGui::Checkbox("Alias", &alias);
+        ImGui::Text("passes: %d  resources: %d  textures: %d", (int)passes.size(), (int)resources.size(), (int)pool.size());
+        ImGui::Text("transient: %.1f MB, allocated %.1f MB", requestedBytes / 1048576.0, allocatedBytes / 1048576.0);
+        if (ImGui::Button("Dump")) dumpToConsole = true;
+        ImGui::SameLine();
+        if (ImGui::Button("Refresh")) Dump();
+        if (!lastDump.empty()) ImGui::TextUnformatted(lastDump.c_str());
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
 }
 
 #pragma endregion
 
 
-// ====================== Transform 变换组件 ======================
-#pragma region Transform : MonoBehavior
+// ====================== Particles 粒子系统 ======================
+#pragma region Particles
+
+// 粒子状态按字段分成连续数组（数组结构体），更新内核一次处理4或8个粒子
+enum ParticleStream { PS_PX, PS_PY, PS_PZ, PS_VX, PS_VY, PS_VZ, PS_AGE, PS_LIFE, PS_COUNT };
+
+// 每个粒子的实例数据（实例化绘制，属性除数为1）
+// 着色器约定（particle.vert）：layout(location = 0) in vec2 corner; layout(location = 1) in vec4 positionSize;
+// layout(location = 2) in vec4 color; 用viewMat的前三行取相机右、上方向展开成朝向相机的四边形
+struct ParticleInstance {
+    vec4 positionSize;   // xyz：世界坐标 w：尺寸
+    unsigned int color;  // RGBA8
+};
+
+// 更新内核：处理[begin, end)（按8对齐），accel的xyz为重力、w为阻力
+typedef void(*ParticleKernel)(float* const* s, const vec4& accel, float dt, int begin, int end);
+
+// 粒子发射器组件（粒子在世界空间模拟，发射器移动不影响已发射的粒子）
+class ParticleEmitter : public MonoBehavior {
+public:
+    enum class Blend { Additive, Alpha };
+    int maxParticles = 100000;   // 粒子池容量（一次分配，之后不再按粒子分配）
+    float rate = 2000;           // 每秒发射数
+    float lifetime = 2, lifetimeVariance = 0.5f;
+    float speed = 3, spread = 0.3f; // 沿Up方向的初速度和方向扰动
+    float radius = 0.1f;         // 发射球半径
+    vec3 gravity = vec3(0, -9.8f, 0);
+    float drag = 0.1f;
+    float startSize = 0.1f, endSize = 0.02f;
+    vec4 startColor = vec4(1, 0.6f, 0.2f, 1), endColor = vec4(0.3f, 0.1f, 0.05f, 0);
+    Blend blend = Blend::Additive;
+    bool sort = true;            // 只对Alpha混合有效（叠加混合与顺序无关）
+    int alive = 0;
+    ParticleEmitter();
+    ~ParticleEmitter();
+    void RealUpdate() override;
+    void OnGUI() const override;
+    void Simulate(float dt);
+    void Draw() const;           // 一次实例化绘制（着色器和混合状态由Particles设置）
+private:
+    void Allocate();
+    void Emit(int count);
+    void Fill(const vec3& eye);
+    void Upload();
+    std::vector<float> streams[PS_COUNT];
+    std::vector<int> chunkAlive;
+    std::vector<ParticleInstance> instances, sorted;
+    std::vector<unsigned long long> sortKeys[2];
+    int capacity = 0;
+    float emitCarry = 0;
+    unsigned int rng = 0x9E3779B9u;
+    GLuint vao = 0, instanceBuffer = 0;
+    int uploadedCapacity = 0;
+};
+
+// 粒子系统（发射器列表、共享的四边形和着色器、按视图绘制）
+class Particles {
+public:
+    static std::vector<ParticleEmitter*> emitters;
+    static int chunkSize;               // 按块并行更新和压缩（块内原地压缩，块之间整体移动）
+    static ParticleKernel Kernel();
+    static GLuint QuadBuffer();
+    static bool HasWork();
+    static void Render(const mat4& view, const mat4& proj); // RenderPipeline在天空盒之后按视图调用
+    static void EndFrame();
+    static void OnGUI();
+    static long long frameLive;         // 本帧累计（EndFrame时显示）
+    static float frameMs;
+private:
+    static ParticleKernel kernel;
+    static GLuint quad;
+    static Shader* shader;
+    static long long shownLive;
+    static float shownMs;
+};
+
+// 静态成员初始化
+std::vector<ParticleEmitter*> Particles::emitters;
+int Particles::chunkSize = 16384;
+long long Particles::frameLive = 0;
+float Particles::frameMs = 0;
+ParticleKernel Particles::kernel = nullptr;
+GLuint Particles::quad = 0;
+Shader* Particles::shader = nullptr;
+long long Particles::shownLive = 0;
+float Particles::shownMs = 0;
+
+// ---- SSE2（4路） ----
+static void UpdateParticlesSSE(float* const* s, const vec4& accel, float dt, int begin, int end) {
+    __m128 gx = _mm_set1_ps(accel.x * dt), gy = _mm_set1_ps(accel.y * dt), gz = _mm_set1_ps(accel.z * dt);
+    __m128 damp = _mm_set1_ps(std::max(0.0f, 1 - accel.w * dt)), step = _mm_set1_ps(dt);
+    for (int i = begin; i < end; i += 4) {
+        __m128 vx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(s[PS_VX] + i), damp), gx);
+        __m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(s[PS_VY] + i), damp), gy);
+        __m128 vz = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(s[PS_VZ] + i), damp), gz);
+        _mm_storeu_ps(s[PS_VX] + i, vx);
+        _mm_storeu_ps(s[PS_VY] + i, vy);
+        _mm_storeu_ps(s[PS_VZ] + i, vz);
+        _mm_storeu_ps(s[PS_PX] + i, _mm_add_ps(_mm_loadu_ps(s[PS_PX] + i), _mm_mul_ps(vx, step)));
+        _mm_storeu_ps(s[PS_PY] + i, _mm_add_ps(_mm_loadu_ps(s[PS_PY] + i), _mm_mul_ps(vy, step)));
+        _mm_storeu_ps(s[PS_PZ] + i, _mm_add_ps(_mm_loadu_ps(s[PS_PZ] + i), _mm_mul_ps(vz, step)));
+        _mm_storeu_ps(s[PS_AGE] + i, _mm_add_ps(_mm_loadu_ps(s[PS_AGE] + i), step));
+    }
+}
 
-// 平移操作（世界空间平移）
-void Transform::Translate(vec3 movement) {
-    position += movement; // 直接更新位置
+// ---- AVX2（8路） ----
+TARGET_AVX2 static void UpdateParticlesAVX2(float* const* s, const vec4& accel, float dt, int begin, int end) {
+    __m256 gx = _mm256_set1_ps(accel.x * dt), gy = _mm256_set1_ps(accel.y * dt), gz = _mm256_set1_ps(accel.z * dt);
+    __m256 damp = _mm256_set1_ps(std::max(0.0f, 1 - accel.w * dt)), step = _mm256_set1_ps(dt);
+    for (int i = begin; i < end; i += 8) {
+        __m256 vx = _mm256_fmadd_ps(_mm256_loadu_ps(s[PS_VX] + i), damp, gx);
+        __m256 vy = _mm256_fmadd_ps(_mm256_loadu_ps(s[PS_VY] + i), damp, gy);
+        __m256 vz = _mm256_fmadd_ps(_mm256_loadu_ps(s[PS_VZ] + i), damp, gz);
+        _mm256_storeu_ps(s[PS_VX] + i, vx);
+        _mm256_storeu_ps(s[PS_VY] + i, vy);
+        _mm256_storeu_ps(s[PS_VZ] + i, vz);
+        _mm256_storeu_ps(s[PS_PX] + i, _mm256_fmadd_ps(vx, step, _mm256_loadu_ps(s[PS_PX] + i)));
+        _mm256_storeu_ps(s[PS_PY] + i, _mm256_fmadd_ps(vy, step, _mm256_loadu_ps(s[PS_PY] + i)));
+        _mm256_storeu_ps(s[PS_PZ] + i, _mm256_fmadd_ps(vz, step, _mm256_loadu_ps(s[PS_PZ] + i)));
+        _mm256_storeu_ps(s[PS_AGE] + i, _mm256_add_ps(_mm256_loadu_ps(s[PS_AGE] + i), step));
+    }
 }
 
-// 获取模型矩阵（包含平移、旋转、缩放，支持世界矩阵叠加）
-mat4 Transform::GetModelMaterix(mat4 world) const {
-    mat4 model = world;
-    model = translate(model, position);       // 平移
-    model = glm::scale(model, scale);         // 缩放
-    // 按顺序应用欧拉角旋转（X-Y-Z轴）
-    model = rotate(model, radians(rotation.x), vec3(1, 0, 0)); // X轴旋转
-    model = rotate(model, radians(rotation.y), vec3(0, 1, 0)); // Y轴旋转
-    model = rotate(model, radians(rotation.z), vec3(0, 0, 1)); // Z轴旋转
-    return model;
+ParticleKernel Particles::Kernel() {
+    if (!kernel) kernel = CpuHasAVX2() ? UpdateParticlesAVX2 : UpdateParticlesSSE;
+    return kernel;
 }
 
-// ImGui 调试界面（显示变换参数）
-void Transform::OnGUI() const {
-    MonoBehavior::OnGUI(); // 显示基类的启用状态复选框
-    // 拖动条显示位置、旋转、缩放参数
-    ImGui::DragFloat3((gameObject->name + "_position").c_str(), (float*)&position, 0.5f, -500, 500);
-    ImGui::DragFloat3((gameObject->name + "_rotation").c_str(), (float*)&rotation, 0.5f, -500, 500);
-    ImGui::DragFloat3((gameObject->name + "_scale").c_str(), (float*)&scale, 0.01f, -100, 100);
-    // 显示相机相关的偏航角和俯仰角
-    ImGui::DragFloat((gameObject->name + "_Yaw").c_str(), (float*)&Yaw, 0.01f, -10, 10);
-    ImGui::DragFloat((gameObject->name + "_Pitch").c_str(), (float*)&Pitch, 0.01f, -10, 10);
+// 所有发射器共用的单位四边形（三角形带）
+GLuint Particles::QuadBuffer() {
+    if (!quad) {
+        const float corners[8] = { -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f };
+        glGenBuffers(1, &quad);
+        glBindBuffer(GL_ARRAY_BUFFER, quad);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    }
+    return quad;
 }
 
-// 物理更新（计算世界空间方向向量）
-void Transform::RealUpdate() {
+bool Particles::HasWork() {
+    for (auto e : emitters)
+        if (e->alive > 0 && e->enable && e->gameObject->enable) return true;
+    return false;
+}
+
+// 绘制所有发射器（开启深度测试、关闭深度写入；每个发射器一次实例化绘制）
+void Particles::Render(const mat4 & view, const mat4 & proj) {
+    if (!shader) shader = new Shader("particle");
+    shader->use();
+    shader->setMat4("viewMat", view);
+    shader->setMat4("projMat", proj);
+    glEnable(GL_BLEND);
+    glDepthMask(GL_FALSE);
+    for (auto e : emitters) {
+        if (e->alive == 0 || !e->enable || !e->gameObject->enable) continue;
+        if (e->blend == ParticleEmitter::Blend::Additive) glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+        else glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        e->Draw();
+    }
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+}
+
+void Particles::EndFrame() {
+    shownLive = frameLive;
+    shownMs = frameMs;
+    frameLive = 0;
+    frameMs = 0;
+}
+
+// ImGui 调试界面（显示发射器数量、存活粒子数和模拟耗时）
+void Particles::OnGUI() {
+    if (ImGui::TreeNode("Particles")) {
+        ImGui::DragInt("ChunkSize", &chunkSize, 1024, 1024, 1 << 20);
+        ImGui::Text("emitters: %d  kernel: %s", (int)emitters.size(), kernel == UpdateParticlesAVX2 ? "AVX2" : "SSE2");
+        ImGui::Text("live: %lld  simulate: %.2f ms", shownLive, shownMs);
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+// 简单的xorshift随机数（每个发射器一个状态，发射时不加锁）
+static float Random01(unsigned int& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+static vec3 RandomInSphere(unsigned int& state) {
+    for (;;) {
+        vec3 p(Random01(state) * 2 - 1, Random01(state) * 2 - 1, Random01(state) * 2 - 1);
+        if (dot(p, p) <= 1) return p;
+    }
+}
+
+// 构造函数（设置组件名称，加入发射器列表）
+ParticleEmitter::ParticleEmitter() {
+    name += "ParticleEmitter"; // 设置组件名称
+    rng ^= (unsigned int)(Particles::emitters.size() * 2654435761u);
+    Particles::emitters.push_back(this);
+}
+
+// 析构函数（从发射器列表移除，释放GPU对象）
+ParticleEmitter::~ParticleEmitter() {
+    auto& list = Particles::emitters;
+    list.erase(std::remove(list.begin(), list.end(), this), list.end());
+    if (vao) glDeleteVertexArrays(1, &vao);
+    if (instanceBuffer) glDeleteBuffers(1, &instanceBuffer);
+}
+
+// 物理更新（模拟一帧）
+void ParticleEmitter::RealUpdate() {
     MonoBehavior::RealUpdate();
-    // 根据欧拉角计算前向向量
-    Forward.x = cos(Pitch) * sin(Yaw);
-    Forward.y = sin(Pitch);
-    Forward.z = cos(Pitch) * cos(Yaw);
-    // 计算右向和上向向量（基于世界上方向）
-    Right = normalize(cross(Forward, WorldUp)); // 右向 = 前向 × 世界上向
-    Up = normalize(cross(Forward, Right));      // 上向 = 前向 × 右向（确保正交）
+    Simulate(Setting::deltaTime);
 }
 
-// 构造函数（初始化变换参数并计算初始方向）
-Transform::Transform(vec3 pos, vec3 rotation, vec3 scale) 
-    : position(pos), rotation(rotation), scale(scale) {
-    name += "Transform"; // 设置组件名称
-    // 初始方向计算（与RealUpdate逻辑一致）
-    Forward.x = cos(Pitch) * sin(Yaw);
-    Forward.y = sin(Pitch);
-    Forward.z = cos(Pitch) * cos(Yaw);
-    Right = normalize(cross(Forward, WorldUp));
-    Up = normalize(cross(Right, Forward));
+// 粒子池容量变化时重新分配（保留已有粒子，长度按8补齐）
+void ParticleEmitter::Allocate() {
+    capacity = std::max(maxParticles, 0);
+    size_t padded = ((size_t)capacity + 7) & ~(size_t)7;
+    for (auto& s : streams) s.resize(padded, 0.0f);
+    instances.resize(capacity);
+    alive = std::min(alive, capacity);
 }
 
-// 析构函数（无资源释放，留空）
-Transform::~Transform() {}
+// 在末尾追加新粒子
+void ParticleEmitter::Emit(int count) {
+    vec3 origin = gameObject->transform()->position;
+    vec3 up = gameObject->transform()->Up;
+    for (int i = alive; i < alive + count; i++) {
+        vec3 p = origin + RandomInSphere(rng) * radius;
+        vec3 v = normalize(up + RandomInSphere(rng) * spread) * speed;
+        streams[PS_PX][i] = p.x; streams[PS_PY][i] = p.y; streams[PS_PZ][i] = p.z;
+        streams[PS_VX][i] = v.x; streams[PS_VY][i] = v.y; streams[PS_VZ][i] = v.z;
+        streams[PS_AGE][i] = 0;
+        streams[PS_LIFE][i] = std::max(0.01f, lifetime + (Random01(rng) * 2 - 1) * lifetimeVariance);
+    }
+    alive += count;
+}
+
+// 模拟：按块并行更新并在块内原地压缩死亡粒子，块之间整体前移，最后发射新粒子并写入实例数据
+void ParticleEmitter::Simulate(float dt) {
+    auto start = std::chrono::high_resolution_clock::now();
+    if (capacity != maxParticles) Allocate();
+    float* s[PS_COUNT];
+    for (int i = 0; i < PS_COUNT; i++) s[i] = streams[i].data();
+
+    if (alive > 0) {
+        int chunk = std::max(8, Particles::chunkSize & ~7);
+        int chunks = (alive + chunk - 1) / chunk;
+        chunkAlive.resize(chunks);
+        ParticleKernel kernel = Particles::Kernel();
+        vec4 accel(gravity, drag);
+        int count = alive;
+        Jobs::ParallelFor(chunks, 1, [&](int first, int last) {
+            for (int c = first; c < last; c++) {
+                int begin = c * chunk, end = std::min(begin + chunk, count);
+                kernel(s, accel, dt, begin, (end + 7) & ~7); // 补齐部分的结果不会被读取
+                int write = begin;
+                for (int i = begin; i < end; i++) {
+                    if (s[PS_AGE][i] >= s[PS_LIFE][i]) continue;
+                    if (write != i)
+                        for (int f = 0; f < PS_COUNT; f++) s[f][write] = s[f][i];
+                    write++;
+                }
+                chunkAlive[c] = write - begin;
+            }
+        });
+        int cursor = chunkAlive[0];
+        for (int c = 1; c < chunks; c++) {
+            for (int f = 0; f < PS_COUNT; f++)
+                memmove(s[f] + cursor, s[f] + (size_t)c * chunk, chunkAlive[c] * sizeof(float));
+            cursor += chunkAlive[c];
+        }
+        alive = cursor;
+    }
+
+    emitCarry += rate * dt;
+    int count = std::min((int)emitCarry, capacity - alive);
+    emitCarry -= (int)emitCarry;
+    if (count > 0) Emit(count);
+
+    if (alive > 0) {
+        Fill(Setting::MainCamera ? Setting::MainCamera->gameObject->transform()->position : vec3(0));
+        Upload();
+    }
+    Particles::frameLive += alive;
+    Particles::frameMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// 写入实例数据（并行）；Alpha混合时按到主相机的距离由远到近排序（其他视图沿用主相机的顺序）
+void ParticleEmitter::Fill(const vec3 & eye) {
+    const float* s[PS_COUNT];
+    for (int i = 0; i < PS_COUNT; i++) s[i] = streams[i].data();
+    Jobs::ParallelFor(alive, 4096, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            float t = s[PS_AGE][i] / s[PS_LIFE][i];
+            vec4 c = clamp(mix(startColor, endColor, t), 0.0f, 1.0f) * 255.0f + 0.5f;
+            instances[i].positionSize = vec4(s[PS_PX][i], s[PS_PY][i], s[PS_PZ][i], startSize + (endSize - startSize) * t);
+            instances[i].color = (unsigned int)c.x | (unsigned int)c.y << 8 | (unsigned int)c.z << 16 | (unsigned int)c.w << 24;
+        }
+    });
+    if (blend != Blend::Alpha || !sort) return;
+
+    // 基数排序（键是距离平方的位模式取反：正浮点数的位模式与大小同序，取反后由远到近）
+    for (auto& k : sortKeys) k.resize(capacity);
+    unsigned long long* keys = sortKeys[0].data();
+    unsigned long long* temp = sortKeys[1].data();
+    for (int i = 0; i < alive; i++) {
+        float dx = s[PS_PX][i] - eye.x, dy = s[PS_PY][i] - eye.y, dz = s[PS_PZ][i] - eye.z;
+        float d = dx * dx + dy * dy + dz * dz;
+        unsigned int bits;
+        memcpy(&bits, &d, sizeof(bits));
+        keys[i] = (unsigned long long)~bits << 32 | (unsigned int)i;
+    }
+    for (int shift = 32; shift < 64; shift += 8) {
+        int offsets[256] = { 0 };
+        for (int i = 0; i < alive; i++) offsets[keys[i] >> shift & 255]++;
+        for (int b = 0, sum = 0; b < 256; b++) { int n = offsets[b]; offsets[b] = sum; sum += n; }
+        for (int i = 0; i < alive; i++) temp[offsets[keys[i] >> shift & 255]++] = keys[i];
+        std::swap(keys, temp);
+    }
+    sorted.resize(capacity);
+    for (int i = 0; i < alive; i++) sorted[i] = instances[(unsigned int)keys[i]];
+}
+
+// 上传实例数据（先丢弃旧存储，不等待GPU读完上一帧）
+void ParticleEmitter::Upload() {
+    if (!vao) {
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &instanceBuffer);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, Particles::QuadBuffer());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0); // 四边形角点
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, positionSize)); // 位置和尺寸
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, color)); // 颜色
+        glVertexAttribDivisor(2, 1);
+        glBindVertexArray(0);
+    }
+    const ParticleInstance* data = blend == Blend::Alpha && sort ? sorted.data() : instances.data();
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * sizeof(ParticleInstance), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)alive * sizeof(ParticleInstance), data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleEmitter::Draw() const {
+    glBindVertexArray(vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, alive);
+}
+
+// ImGui 调试界面（显示发射参数和存活粒子数）
+void ParticleEmitter::OnGUI() const {
+    MonoBehavior::OnGUI(); // 显示基类的启用状态复选框
+    ImGui::Text("alive: %d / %d", alive, capacity);
+    ImGui::DragInt("maxParticles", (int*)&maxParticles, 1000, 0, 4000000);
+    ImGui::DragFloat("rate", (float*)&rate, 10, 0, 1000000);
+    ImGui::DragFloat("lifetime", (float*)&lifetime, 0.05f, 0.01f, 60);
+    ImGui::DragFloat("speed", (float*)&speed, 0.05f, 0, 100);
+    ImGui::DragFloat("spread", (float*)&spread, 0.01f, 0, 10);
+    ImGui::DragFloat3("gravity", (float*)&gravity, 0.1f);
+    ImGui::DragFloat("drag", (float*)&drag, 0.01f, 0, 10);
+    ImGui::ColorEdit4("startColor", (float*)&startColor);
+    ImGui::ColorEdit4("endColor", (float*)&endColor);
+    bool alpha = blend == Blend::Alpha;
+    if (ImGui::Checkbox("alphaBlend", &alpha)) *(Blend*)&blend = alpha ? Blend::Alpha : Blend::Additive;
+    ImGui::Checkbox("sort", (bool*)&sort);
+}
+
+#pragma endregion
+
+
+// ====================== DynamicResolution 动态分辨率 ======================
+#pragma region DynamicResolution
+
+// 动态分辨率：每个视图的场景画到按比例缩小的临时目标，合成时线性放大到窗口视口
+// （ImGui在场景之后直接画在窗口上，保持原生分辨率）；比例由GPU计时查询测得的场景耗时驱动
+class DynamicResolution {
+public:
+    static bool enable;
+    static float targetMs;      // 场景GPU耗时目标
+    static float minScale, maxScale;
+    static float damping;       // 每次测量后向理想比例靠近的比例（越小越平稳）
+    static float step;          // 比例量化步长（渲染图按尺寸复用纹理，避免每帧都是新尺寸）
+    static float scale;         // 当前比例（每个轴）
+    static float gpuMs;         // 最近一次测得的场景GPU耗时
+    static ivec2 Scaled(int width, int height);
+    static void BeginFrame();   // 声明渲染图之前：读取已完成的查询、更新比例、开始计时
+    static void EndFrame();     // 执行渲染图之后：结束计时
+    static void OnGUI();
+private:
+    static void Adjust(float measuredScale);
+    static const int queryCount = 4; // 查询轮转，只读取已完成的结果，不阻塞
+    static GLuint queries[queryCount];
+    static bool pending[queryCount];
+    static float queryScales[queryCount]; // 发出查询的那一帧使用的比例（结果晚几帧才回来）
+    static int current;
+    static bool timing;
+    static float desired;       // 未量化的比例
+};
+
+// 静态成员初始化
+bool DynamicResolution::enable = true;
+float DynamicResolution::targetMs = 12.0f;
+float DynamicResolution::minScale = 0.5f;
+float DynamicResolution::maxScale = 1.0f;
+float DynamicResolution::damping = 0.15f;
+float DynamicResolution::step = 0.05f;
+float DynamicResolution::scale = 1.0f;
+float DynamicResolution::gpuMs = 0;
+GLuint DynamicResolution::queries[DynamicResolution::queryCount] = { 0 };
+bool DynamicResolution::pending[DynamicResolution::queryCount] = { false };
+float DynamicResolution::queryScales[DynamicResolution::queryCount] = { 1.0f, 1.0f, 1.0f, 1.0f };
+int DynamicResolution::current = 0;
+bool DynamicResolution::timing = false;
+float DynamicResolution::desired = 1.0f;
+
+ivec2 DynamicResolution::Scaled(int width, int height) {
+    return ivec2(std::max(1, (int)(width * scale + 0.5f)), std::max(1, (int)(height * scale + 0.5f)));
+}
+
+// 片段开销与像素数（比例的平方）成正比，理想比例 = 测量时的比例 * sqrt(目标 / 实测)
+// （用当前比例会在结果返回前已经调整过比例时重复修正，造成振荡）
+void DynamicResolution::Adjust(float measuredScale) {
+    if (!enable) {
+        desired = scale = 1.0f;
+        return;
+    }
+    float ideal = measuredScale * std::sqrt(targetMs / std::max(gpuMs, 0.01f));
+    desired += (ideal - desired) * damping;
+    desired = std::max(minScale, std::min(desired, maxScale));
+    float quantized = std::round(desired / step) * step;
+    scale = std::max(minScale, std::min(quantized, maxScale));
+}
+
+void DynamicResolution::BeginFrame() {
+    if (!queries[0]) glGenQueries(queryCount, queries);
+    // 从最早发出的查询开始读取
+    for (int i = 1; i <= queryCount; i++) {
+        int q = (current + i) % queryCount;
+        if (!pending[q]) continue;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[q], GL_QUERY_RESULT, &ns);
+        pending[q] = false;
+        gpuMs = ns / 1e6f;
+        Adjust(queryScales[q]);
+    }
+    current = (current + 1) % queryCount;
+    timing = !pending[current]; // 四帧前的查询仍未完成时本帧不计时
+    if (timing) {
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+        queryScales[current] = scale;
+    }
+}
+
+void DynamicResolution::EndFrame() {
+    if (!timing) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[current] = true;
+    timing = false;
+}
+
+// ImGui 调试界面（显示当前比例和耗时）
+void DynamicResolution::OnGUI() {
+    if (ImGui::TreeNode("DynamicResolution")) {
+        ImGui::Checkbox("Enable", &enable);
+        ImGui::DragFloat("TargetMs", &targetMs, 0.1f, 1, 100);
+        ImGui::SliderFloat("MinScale", &minScale, 0.25f, 1);
+        ImGui::SliderFloat("MaxScale", &maxScale, minScale, 1);
+        ImGui::SliderFloat("Damping", &damping, 0.01f, 1);
+        ImGui::Text("scale: %.2f (%.0f%% pixels)", scale, scale * scale * 100);
+        ImGui::Text("scene gpu: %.2f ms  frame: %.2f ms", gpuMs, Setting::deltaTime * 1000);
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+#pragma endregion
+
+
+// ====================== RenderPipeline 渲染通道 ======================
+#pragma region RenderPipeline
+
+// 渲染通道（组件在RealUpdate中只提交，RenderFrame按固定顺序绘制：
+// 深度预渲染 -> 着色（GL_EQUAL）-> 天空盒（远平面，只填充未被覆盖的像素））
+//
+// 调用顺序：主相机每次RealUpdate开头调用 BeginFrame，它先用 RenderFrame 绘制上一次以来收集的提交，
+// 再开始收集新的一轮。主循环不需要单独调用，两次主相机更新之间每个组件恰好提交一次，
+// 与组件在对象列表中的先后无关（排在主相机前面的组件的提交在下一次主相机更新时绘制）。
+// 帧边界的工作（WorldStreamer::Update、TransformBatch/MeshletCulling/Particles::EndFrame、FrameArena::Reset）
+// 都在 RenderFrame 末尾执行；没有启用的主相机时不绘制，提交在下一次绘制时一并处理
+// 多视图：每个启用的相机登记一个视图；场景遍历、模型矩阵和逐绘制数据上传每帧只做一次，
+// 每个视图只有自己的剔除结果和一个轻量的绘制列表
+class RenderPipeline {
+public:
+    struct OpaqueItem {
+        ModelRender* render;
+        mat4 model;
+        unsigned int viewMask; // 在哪些视图中可见
+        GLintptr drawOffset;   // 已写入的逐绘制数据（-1为每次绘制时再写）
+    };
+    struct View {
+        Camera* camera;
+        mat4 view, proj;
+        vec4 viewPort;
+        vec3 position;
+        int index;             // 视图位（SpatialIndex中的视图掩码）
+        GLintptr frameOffset;  // 该视图的每帧数据
+    };
+    static bool depthPrepass;            // 是否开启深度预渲染
+    static void AddView(Camera* camera, const mat4& view, const mat4& proj); // Camera::RealUpdate每帧调用
+    static void Submit(ModelRender* render, const mat4& model);
+    static void SubmitSky(SkyboxRender* sky);
+    static void BeginFrame();            // 主相机RealUpdate开头调用：绘制已收集的一轮（如有），开始新的一轮
+    static void RenderFrame();           // 绘制已收集的提交并结束这一轮（由BeginFrame调用）
+    static void Withdraw(ModelRender* render);  // 组件析构时撤回还没绘制的提交
+    static void Withdraw(SkyboxRender* skybox);
+    static void OnGUI();
+    static int opaqueCount;
+    static const int maxViews = 32;
+private:
+    struct DrawRef {
+        float distance;   // 到该视图相机距离的平方（由近到远排序）
+        int item;
+    };
+    struct ViewDraws {    // 一个视图的绘制列表（帧内存，供该视图的各个通道使用）
+        const View* view;
+        DrawRef* list;
+        int count;
+    };
+    static void AddViewPasses(const View& view, int backbuffer);
+    static void ApplyView(const View& view);
+    static void DepthPass(const ViewDraws& draws);
+    static void OpaquePass(ViewDraws& draws, bool prepass);
+    static void SkyPass(const ViewDraws& draws);
+    static void ParticlePass(const ViewDraws& draws);
+    static std::vector<OpaqueItem> opaque;
+    static std::vector<View> views;
+    static std::vector<int> viewDraws;   // 上一帧每个视图的绘制数（调试界面显示）
+    static SkyboxRender* sky;
+    static Shader* depthShader;
+    static bool collecting;              // 主相机已开始收集一轮提交
+};
+
+// 静态成员初始化
+bool RenderPipeline::depthPrepass = true;
+int RenderPipeline::opaqueCount = 0;
+std::vector<RenderPipeline::OpaqueItem> RenderPipeline::opaque;
+std::vector<RenderPipeline::View> RenderPipeline::views;
+std::vector<int> RenderPipeline::viewDraws;
+SkyboxRender* RenderPipeline::sky = nullptr;
+Shader* RenderPipeline::depthShader = nullptr;
+bool RenderPipeline::collecting = false;
+
+// 登记视图并立即做该视图的视锥剔除（本帧第一个视图先同步空间索引）
+void RenderPipeline::AddView(Camera * camera, const mat4 & view, const mat4 & proj) {
+    if (views.empty()) SpatialIndex::BeginFrame();
+    if ((int)views.size() == maxViews) return;
+    View v{ camera, view, proj, camera->viewPort, camera->transform->position, (int)views.size(), -1 };
+    SpatialIndex::CullView(v.index, proj * view);
+    views.push_back(v);
+}
+
+// 提交不透明物体（与视图无关，剔除在RenderFrame中按视图进行）
+void RenderPipeline::Submit(ModelRender * render, const mat4 & model) {
+    opaque.push_back({ render, model, 0, -1 });
+}
+
+// 提交天空盒（每帧只绘制一个）
+void RenderPipeline::SubmitSky(SkyboxRender * skybox) {
+    sky = skybox;
+}
+
+// 对象可能在提交之后、绘制之前被销毁（脚本删除、编辑器操作），撤回它的提交
+void RenderPipeline::Withdraw(ModelRender * render) {
+    opaque.erase(std::remove_if(opaque.begin(), opaque.end(), [render](const OpaqueItem& item) { return item.render == render; }),
+        opaque.end());
+}
+
+void RenderPipeline::Withdraw(SkyboxRender * skybox) {
+    if (sky == skybox) sky = nullptr;
+}
+
+void RenderPipeline::BeginFrame() {
+    if (collecting) RenderFrame();
+    collecting = true;
+}
+
+void RenderPipeline::RenderFrame() {
+    if (!depthShader) depthShader = new Shader("depth"); // 只有位置的深度着色器
+    opaqueCount = (int)opaque.size();
+    viewDraws.assign(views.size(), 0);
+    if (!views.empty()) {
+        SpatialIndex::AssignLights(); // 所有视图都剔除完之后只分配一次
+        // 主视图最先绘制，其余视图（分屏、画中画、小地图）按登记顺序叠加
+        std::stable_sort(views.begin(), views.end(), [](const View& a, const View& b) {
+            return a.camera == Setting::MainCamera && b.camera != Setting::MainCamera;
+        });
+        int mainBit = -1;
+        for (auto& view : views) {
+            if (view.camera == Setting::MainCamera) {
+                view.frameOffset = UniformRing::MainView(); // 主相机的每帧数据已在BeginFrame中写入
+                mainBit = view.index;
+            } else {
+                view.frameOffset = UniformRing::PushView(view.view, view.proj, view.position);
+            }
+        }
+
+        // 每个物体只做一次：合并视图掩码、主视图遮挡测试、写入逐绘制数据
+        // （本帧区域放不下时退回每次绘制再写，避免回绕覆盖还要被其他视图使用的数据）
+        bool shared = UniformRing::DrawsRemaining() >= (int)opaque.size();
+        for (auto& item : opaque) {
+            GameObject* object = item.render->gameObject;
+            item.viewMask = SpatialIndex::ViewMask(object);
+            if (mainBit >= 0 && (item.viewMask >> mainBit & 1)
+                && !OcclusionCulling::IsVisible(item.render->model->boundsMin, item.render->model->boundsMax, item.model))
+                item.viewMask &= ~(1u << mainBit); // 被遮挡体完全挡住
+            item.drawOffset = -1;
+            if (item.viewMask) Animation::MarkVisible(object); // 可见的角色下一帧不降频
+            if (item.viewMask && shared && item.render->material->shader->uniformBlocks) {
+                UniformRing::drawLightMask = SpatialIndex::LightMask(object);
+                UniformRing::drawSkinned = Animation::IsSkinned(object);
+                item.drawOffset = UniformRing::WriteDraw(MaterialDrawUniforms(item.render->material, item.model));
+            }
+        }
+        UniformRing::drawSkinned = 0;
+
+        // 每个视图：深度预渲染 -> 着色 -> 天空盒画到自己的临时目标，再合成到窗口（或离屏FBO）的视口区域
+        DynamicResolution::BeginFrame(); // 按上几帧测得的耗时调整本帧的渲染比例
+        RenderGraph::Reset();
+        int backbuffer = RenderGraph::ImportFramebuffer("Backbuffer", Headless::framebuffer, (int)Setting::windowSize.x, (int)Setting::windowSize.y);
+        for (auto& view : views)
+            AddViewPasses(view, backbuffer);
+        RenderGraph::Compile();
+        RenderGraph::Execute();
+        DynamicResolution::EndFrame();
+    }
+
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    opaque.clear();
+    views.clear();
+    sky = nullptr;
+    // 提交已清空、新一轮还没有提交，在这里分批创建/销毁单元对象（只删除单元对象，不会删除正在执行的主相机对象）
+    WorldStreamer::Update();
+    TransformBatch::EndFrame(); // 下一帧的第一个Transform重新批量更新
+    MeshletCulling::EndFrame();
+    Particles::EndFrame();
+    FrameArena::Reset(); // 帧结束，释放本帧的临时数据
+}
+
+// 声明一个视图的通道（绘制列表只包含该视图可见的物体，引用共用的模型矩阵和逐绘制数据）
+void RenderPipeline::AddViewPasses(const View & view, int backbuffer) {
+    ViewDraws* draws = FrameArena::Allocate<ViewDraws>(1);
+    draws->view = &view;
+    draws->list = FrameArena::Allocate<DrawRef>(opaque.size() + 1);
+    draws->count = 0;
+    for (int i = 0; i < (int)opaque.size(); i++) {
+        if (!(opaque[i].viewMask >> view.index & 1)) continue;
+        vec3 offset = vec3(opaque[i].model[3]) - view.position;
+        draws->list[draws->count++] = { dot(offset, offset), i };
+    }
+    viewDraws[&view - views.data()] = draws->count;
+    std::sort(draws->list, draws->list + draws->count, [](const DrawRef& a, const DrawRef& b) { return a.distance < b.distance; });
+
+    string name = "View" + std::to_string(view.index);
+    ivec2 size = DynamicResolution::Scaled((int)view.viewPort.z, (int)view.viewPort.w); // 临时目标按动态分辨率缩放
+    int width = size.x, height = size.y;
+    int color = RenderGraph::Create(name + " Color", width, height, GL_RGBA8);
+    int depth = RenderGraph::Create(name + " Depth", width, height, GL_DEPTH_COMPONENT24);
+    bool prepass = depthPrepass && draws->count > 0;
+    if (prepass) {
+        RenderGraph::AddPass(name + " DepthPrepass", {}, { depth }, [draws] { DepthPass(*draws); });
+        RenderGraph::AddPass(name + " Opaque", { depth }, { color }, [draws] { OpaquePass(*draws, true); });
+    } else {
+        RenderGraph::AddPass(name + " Opaque", {}, { color, depth }, [draws] { OpaquePass(*draws, false); });
+    }
+    if (sky) RenderGraph::AddPass(name + " Sky", { depth, color }, { color }, [draws] { SkyPass(*draws); }); // 画在着色结果之上
+    if (Particles::HasWork()) // 粒子最后混合（深度测试被不透明物体遮挡，不写深度）
+        RenderGraph::AddPass(name + " Particles", { depth, color }, { color }, [draws] { ParticlePass(*draws); });
+    // 合成：把该视图的颜色拷到目标的视口区域（叠加的视图覆盖主视图的一部分），缩放时线性放大
+    RenderGraph::AddPass(name + " Composite", { color }, { backbuffer }, [color, backbuffer, &view, width, height] {
+        vec4 vp = view.viewPort;
+        bool scaled = width != (int)vp.z || height != (int)vp.w;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, RenderGraph::Framebuffer({ color }));
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, RenderGraph::Framebuffer({ backbuffer }));
+        glBlitFramebuffer(0, 0, width, height, (GLint)vp.x, (GLint)vp.y, (GLint)(vp.x + vp.z), (GLint)(vp.y + vp.w),
+            GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST);
+    });
+}
+
+// 视图矩阵写回全局（天空盒和不使用Uniform块的材质仍从这里读取），绑定该视图的每帧数据
+void RenderPipeline::ApplyView(const View & view) {
+    viewMat = view.view;
+    projMat = view.proj;
+    UniformRing::BindView(view.frameOffset);
+    glEnable(GL_DEPTH_TEST);
+}
+
+// 深度预渲染：由近到远只写深度，之后每个像素只着色一次
+// depth.vert与所有着色器都用 invariant gl_Position 和相同的 projMat * viewMat * modelMat 计算顺序，保证深度逐位相同
+void RenderPipeline::DepthPass(const ViewDraws & draws) {
+    ApplyView(*draws.view);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    depthShader->use();
+    depthShader->setMat4("viewMat", viewMat);
+    depthShader->setMat4("projMat", projMat);
+    for (int i = 0; i < draws.count; i++) {
+        const OpaqueItem& item = opaque[draws.list[i].item];
+        depthShader->setMat4("modelMat", item.model);
+        depthShader->setInt("skinned", Animation::Bind(item.render->gameObject));
+        MeshletCulling::Begin(item.model, viewMat, projMat);
+        item.render->model->DrawDepth();
+    }
+    MeshletCulling::End();
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// 着色通道（已写入的逐绘制数据只绑定偏移）
+void RenderPipeline::OpaquePass(ViewDraws & draws, bool prepass) {
+    ApplyView(*draws.view);
+    if (prepass) {
+        // 按着色器分组，减少状态切换（深度已确定，绘制顺序不再影响过度绘制）
+        std::stable_sort(draws.list, draws.list + draws.count, [](const DrawRef& a, const DrawRef& b) {
+            return opaque[a.item].render->material->shader->ID < opaque[b.item].render->material->shader->ID;
+        });
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    } else {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+    for (int i = 0; i < draws.count; i++) {
+        OpaqueItem& item = opaque[draws.list[i].item];
+        UniformRing::sharedDraw = item.drawOffset;
+        MeshletCulling::Begin(item.model, viewMat, projMat); // 与深度预渲染剔除结果相同，GL_EQUAL不受影响
+        item.render->Draw(item.model);
+    }
+    MeshletCulling::End();
+    UniformRing::sharedDraw = -1;
+}
+
+// 天空盒在不透明物体之后绘制：位于远平面（着色器输出z=w），开启深度测试、关闭深度写入
+void RenderPipeline::SkyPass(const ViewDraws & draws) {
+    ApplyView(*draws.view);
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+    sky->Draw();
+}
+
+// 粒子：每个发射器一次实例化绘制，使用该视图的viewMat/projMat
+void RenderPipeline::ParticlePass(const ViewDraws & draws) {
+    ApplyView(*draws.view);
+    glDepthFunc(GL_LESS);
+    Particles::Render(viewMat, projMat);
+}
+
+// ImGui 调试界面（显示通道设置和每个视图的绘制数）
+void RenderPipeline::OnGUI() {
+    if (ImGui::TreeNode("RenderPipeline")) {
+        ImGui::Checkbox("DepthPrepass", &depthPrepass);
+        ImGui::Text("opaque: %d", opaqueCount);
+        for (size_t i = 0; i < viewDraws.size(); i++)
+            ImGui::Text("view %d: %d draws", (int)i, viewDraws[i]);
+        ImGui::TreePop();
+        ImGui::Spacing();
+    }
+}
+
+#pragma endregion
+
+
+// ====================== SceneInspector 场景检视面板 ======================
+#pragma region SceneInspector
+
+// 场景检视面板（层级列表用ImGuiListClipper只绘制可见行；只展开选中对象的组件面板）
+class SceneInspector {
+public:
+    static void Add(GameObject* object);     // GameObject构造时加入名称索引
+    static void Remove(GameObject* object);  // GameObject析构时移出名称索引
+    static void Draw();                      // 主相机RealUpdate每帧调用一次（需在ImGui::NewFrame之后），绘制层级和检视窗口
+private:
+    struct Entry {
+        string key;            // 小写名称（去掉"GameObject_"前缀）
+        GameObject* object;
+    };
+    static string Key(const GameObject* object);
+    static void Flush();                     // 合并本帧的增删（绘制前调用一次）
+    static void UpdateRange();
+    static std::vector<Entry> index;         // 按名称排序（删除的条目先置空，Flush时压缩）
+    static std::vector<Entry> pending;       // 新加入的对象，Flush时排序后一次合并
+    static size_t removed;                   // index中已置空的条目数
+    static size_t rangeBegin, rangeEnd;      // 当前搜索结果在索引中的区间
+    static char search[64];
+    static GameObject* selected;
+};
+
+// 静态成员初始化
+std::vector<SceneInspector::Entry> SceneInspector::index;
+std::vector<SceneInspector::Entry> SceneInspector::pending;
+size_t SceneInspector::removed = 0;
+size_t SceneInspector::rangeBegin = 0;
+size_t SceneInspector::rangeEnd = 0;
+char SceneInspector::search[64] = "";
+GameObject* SceneInspector::selected = nullptr;
+
+// 索引键（名称前缀匹配不区分大小写）
+string SceneInspector::Key(const GameObject * object) {
+    static const string prefix = "GameObject_";
+    string key = object->name.compare(0, prefix.size(), prefix) == 0 ? object->name.substr(prefix.size()) : object->name;
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return key;
+}
+
+static bool EntryLess(const string& a, int idA, const string& b, int idB) {
+    int c = a.compare(b);
+    return c != 0 ? c < 0 : idA < idB;
+}
+
+// 增删只记录，流式加载一帧创建/销毁大量对象时不再逐个移动索引
+void SceneInspector::Add(GameObject * object) {
+    pending.push_back(Entry{ Key(object), object });
+}
+
+void SceneInspector::Remove(GameObject * object) {
+    if (selected == object) selected = nullptr;
+    for (size_t i = 0; i < pending.size(); i++)
+        if (pending[i].object == object) {
+            pending[i] = pending.back();
+            pending.pop_back();
+            return;
+        }
+    string key = Key(object);
+    auto it = std::lower_bound(index.begin(), index.end(), key, [](const Entry& a, const string& k) { return a.key < k; });
+    for (; it != index.end() && it->key == key; ++it)
+        if (it->object == object) {
+            it->object = nullptr; // 对象即将释放，不能再访问
+            removed++;
+            break;
+        }
+}
+
+// 压缩删除的条目，新条目排序后与索引归并，结果区间随之更新
+void SceneInspector::Flush() {
+    if (pending.empty() && removed == 0) return;
+    if (removed) {
+        index.erase(std::remove_if(index.begin(), index.end(), [](const Entry& e) { return !e.object; }), index.end());
+        removed = 0;
+    }
+    if (!pending.empty()) {
+        auto less = [](const Entry& a, const Entry& b) { return EntryLess(a.key, a.object->id, b.key, b.object->id); };
+        std::sort(pending.begin(), pending.end(), less);
+        size_t middle = index.size();
+        index.insert(index.end(), pending.begin(), pending.end());
+        std::inplace_merge(index.begin(), index.begin() + middle, index.end(), less);
+        pending.clear();
+    }
+    UpdateRange();
+}
+
+// 按搜索前缀二分出结果区间（索引已排序，不需要逐个比较）
+void SceneInspector::UpdateRange() {
+    string prefix(search);
+    std::transform(prefix.begin(), prefix.end(), prefix.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    auto begin = std::lower_bound(index.begin(), index.end(), prefix, [](const Entry& a, const string& p) { return a.key < p; });
+    auto end = std::upper_bound(begin, index.end(), prefix, [](const string& p, const Entry& a) {
+        return a.key.compare(0, p.size(), p) > 0;
+    });
+    rangeBegin = begin - index.begin();
+    rangeEnd = end - index.begin();
+}
+
+void SceneInspector::Draw() {
+    Flush(); // 无窗口模式也要合并，否则待合并的条目一直增长
+    if (Headless::enabled || !ImGui::GetCurrentContext()) return; // 无窗口模式没有界面
+    // 在场景中点击选中物体（鼠标未被ImGui占用且未锁定时）
+    if (Setting::MainCamera && !Setting::lockMouse && ImGui::IsMouseClicked(0) && !ImGui::GetIO().WantCaptureMouse) {
+        ImVec2 mouse = ImGui::GetMousePos();
+        Ray ray = SpatialIndex::ScreenPointToRay(Setting::MainCamera, vec2(mouse.x, mouse.y));
+        GameObject* hit = SpatialIndex::Raycast(ray, Setting::MainCamera->gameObject);
+        if (hit) selected = hit;
+    }
+    // 层级窗口：只为可见行提交控件，开销与场景规模无关
+    ImGui::Begin("Hierarchy");
+    if (ImGui::InputText("Search", search, sizeof(search))) UpdateRange();
+    ImGui::Text("%d / %d objects", (int)(rangeEnd - rangeBegin), (int)index.size());
+    ImGui::BeginChild("rows");
+    ImGuiListClipper clipper;
+    clipper.Begin((int)(rangeEnd - rangeBegin));
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            GameObject* object = index[rangeBegin + row].object;
+            ImGui::PushID(object->id);
+            if (ImGui::Selectable(object->name.c_str(), selected == object)) selected = object;
+            ImGui::PopID();
+        }
+    }
+    clipper.End();
+    ImGui::EndChild();
+    ImGui::End();
+
+    // 检视窗口：只绘制选中对象，组件面板折叠时不调用其OnGUI
+    ImGui::Begin("Inspector");
+    if (selected) {
+        ImGui::PushID(selected->id);
+        ImGui::Text("%s", selected->name.c_str());
+        selected->OnGUI();
+        for (auto script : *selected->scripts) {
+            ImGui::PushID(script);
+            if (ImGui::CollapsingHeader(script->name.c_str()))
+                script->OnGUI();
+            ImGui::PopID();
+        }
+        ImGui::PopID();
+    }
+    ImGui::End();
+}
 
 #pragma endregion
 
@@ -175,22 +6848,56 @@ void Camera::Start() {
 // 物理更新（更新视角和投影矩阵）
 void Camera::RealUpdate() {
     MonoBehavior::RealUpdate();
-    // 设置OpenGL视口
-    glViewport(viewPort.x, viewPort.y, viewPort.z, viewPort.w);
+    // 主相机先绘制上一次以来收集的提交（渲染通道的唯一驱动），再开始本轮
+    if (this == Setting::MainCamera) {
+        RenderPipeline::BeginFrame();
+        SceneInspector::Draw();
+    }
     // 计算视图矩阵（从相机视角看世界）
     viewMat = lookAt(transform->position, transform->position + transform->Forward, transform->WorldUp);
     // 计算透视投影矩阵（视角、宽高比、近远裁剪平面）
     projMat = perspective(radians(this->angle), viewPort.z / viewPort.w, near, far);
+    // 主相机负责更新阴影图集（会改动视口和帧缓冲，所以放在设置视口之前）
+    if (this == Setting::MainCamera) {
+        Animation::Update(); // 阴影和所有视图使用同一帧的骨骼矩阵
+        ShadowSystem::Render(this);
+    }
+    // 设置OpenGL视口
+    glViewport(viewPort.x, viewPort.y, viewPort.z, viewPort.w);
+    // 主相机每帧切换环形缓冲区域并上传相机和光照（整帧只上传一次）
+    if (this == Setting::MainCamera) {
+        TextureStreamer::Update(); // 在每帧预算内继续上传更大的mip
+        UniformRing::BeginFrame();
+        OcclusionCulling::Render(viewMat, projMat); // 光栅化遮挡体，供主视图测试
+    }
+    // 每个启用的相机都是一个视图（分屏、画中画、小地图），各自做视锥剔除，共用场景数据
+    RenderPipeline::AddView(this, viewMat, projMat);
 }
 
 // ImGui 调试界面（显示相机参数）
 void Camera::OnGUI() const {
     MonoBehavior::OnGUI(); // 显示基类的启用状态复选框
     // 拖动条显示视口、视角、近远裁剪平面
-    ImGui::DragFloat4(("viewPort" + std::to_string(gameObject->id)).c_str(), (float*)&viewPort, 10, 0, 2000);
-    ImGui::DragFloat(("viewAngle" + std::to_string(gameObject->id)).c_str(), (float*)&angle, 3, 0, 180.0f);
-    ImGui::DragFloat(("near" + std::to_string(gameObject->id)).c_str(), (float*)&near, 0.01f, 0, 10);
-    ImGui::DragFloat(("far" + std::to_string(gameObject->id)).c_str(), (float*)&far, 1.0f, 0, 1000);
+    ImGui::DragFloat4("viewPort", (float*)&viewPort, 10, 0, 2000);
+    ImGui::DragFloat("viewAngle", (float*)&angle, 3, 0, 180.0f);
+    ImGui::DragFloat("near", (float*)&near, 0.01f, 0, 10);
+    ImGui::DragFloat("far", (float*)&far, 1.0f, 0, 1000);
+    if (this == Setting::MainCamera) { // 主相机面板显示遮挡剔除和阴影统计
+        OcclusionCulling::OnGUI();
+        SpatialIndex::OnGUI();
+        ShadowSystem::OnGUI();
+        TextureStreamer::OnGUI();
+        WorldStreamer::OnGUI();
+        Vfs::OnGUI();
+        AllocStats::OnGUI();
+        TransformBatch::OnGUI();
+        MeshletCulling::OnGUI();
+        Animation::OnGUI();
+        Particles::OnGUI();
+        DynamicResolution::OnGUI();
+        RenderPipeline::OnGUI();
+        RenderGraph::OnGUI();
+    }
 }
 
 #pragma endregion
@@ -225,8 +6932,9 @@ void CameraMove::Update() {
     // 空格键切换鼠标锁定状态（控制鼠标是否隐藏）
     if (Input::GetKeyDown(Space_)) {
         Setting::lockMouse = !Setting::lockMouse;
-        // 设置GLFW鼠标模式（禁用或正常）
-        glfwSetInputMode(window, GLFW_CURSOR, Setting::lockMouse ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+        // 设置GLFW鼠标模式（禁用或正常；无窗口模式下没有窗口）
+        if (window)
+            glfwSetInputMode(window, GLFW_CURSOR, Setting::lockMouse ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
     }
 }
 
@@ -354,6 +7062,16 @@ void AbstractLight::SetShader(Shader * shader, int index) {
     shader->setVec3(Sign() + "[" + std::to_string(index) + "]." + "dirToLight", this->direction);
 }
 
+// 填充FrameData块中的光源数据（与SetShader传递的参数一致）
+void AbstractLight::ToUniform(LightUniform & u) const {
+    u.color = vec4(this->color * strength, (float)Type());
+    u.pos = vec4(transform->position, 1);
+    u.dirToLight = vec4(this->direction, 0);
+    u.attenuation = vec4(1, 0, 0, 0); // 无衰减
+    ivec2 shadow = ShadowSystem::TilesOf(this);
+    u.cone = vec4(-1, -1, (float)shadow.x, (float)shadow.y); // 无圆锥限制
+}
+
 // JSON序列化友元函数（允许直接读写AbstractLight对象）
 void to_json(json & j, const AbstractLight & l) {
     l.ToJson(j); // 调用对象的序列化方法
@@ -424,6 +7142,12 @@ void LightPoint::SetShader(Shader * shader, int index) {
     shader->setFloat(Sign() + "[" + std::to_string(index) + "]." + "quadratic", this->quadratic);
 }
 
+// 填充光源Uniform数据（添加衰减参数）
+void LightPoint::ToUniform(LightUniform & u) const {
+    AbstractLight::ToUniform(u);
+    u.attenuation = vec4(constant, linear, quadratic, 0);
+}
+
 // 初始化（设置默认位置和颜色）
 void LightPoint::Start() {
     AbstractLight::Start();
@@ -508,6 +7232,13 @@ void LightSpot::SetShader(Shader * shader, int index) {
     shader->setFloat(Sign() + "[" + std::to_string(index) + "]." + "cosPhyOuter", this->cosPhyOuter);
 }
 
+// 填充光源Uniform数据（添加角度参数）
+void LightSpot::ToUniform(LightUniform & u) const {
+    LightPoint::ToUniform(u);
+    u.cone.x = cosPhyInner;
+    u.cone.y = cosPhyOuter;
+}
+
 #pragma endregion
 
 
@@ -518,8 +7249,10 @@ void LightSpot::SetShader(Shader * shader, int index) {
 void Mesh::Draw(Shader * shader) {
     // 绑定纹理（处理不同类型的纹理：漫反射、高光、法线、高度）
     unsigned int diffuseNr = 0, specularNr = 0, normalNr = 0, heightNr = 0;
-    for (unsigned int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i); // 激活纹理单元
+    // 打包后纹理数组常驻固定单元，采样器在创建着色器时已设置，这里只传各类型纹理的层
+    glVertexAttribI4i(TextureArrays::layerAttribute, packedLayers.x, packedLayers.y, packedLayers.z, packedLayers.w);
+    if (!layers.empty()) TextureArrays::Bind();
+    for (unsigned int i = 0; i < textures.size() && layers.empty(); i++) {
         string name = textures[i].type;
         string number;
         // 根据纹理类型生成编号（如diffuse_texture0）
@@ -527,6 +7260,7 @@ void Mesh::Draw(Shader * shader) {
         else if (name == "texture_specular") number = std::to_string(specularNr++);
         else if (name == "texture_normal") number = std::to_string(normalNr++);
         else if (name == "texture_height") number = std::to_string(heightNr++);
+        glActiveTexture(GL_TEXTURE0 + i); // 激活纹理单元
         // 设置着色器采样器对应的纹理单元
         shader->setInt("material." + (name + number), i);
         glBindTexture(GL_TEXTURE_2D, textures[i].id); // 绑定纹理
@@ -534,7 +7268,7 @@ void Mesh::Draw(Shader * shader) {
 
     // 绘制网格
     glBindVertexArray(vao); // 绑定顶点数组对象
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0); // 绘制三角形
+    MeshletCulling::Draw(vao, (GLsizei)indices.size()); // 绘制三角形（有簇时只提交存活的簇）
     glBindVertexArray(0); // 解绑
 
     glActiveTexture(GL_TEXTURE0); // 恢复默认纹理单元
@@ -549,16 +7283,47 @@ Mesh::Mesh(float vertices[]) {
 
 // 构造函数（从顶点、索引、纹理列表初始化）
 Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
-    : vertices(vertices), indices(indices), textures(textures) {
+    : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)) {
+    // 纹理已打包时记录每个纹理所在的数组层（任一纹理未打包则退回逐个绑定）
+    for (auto& texture : this->textures) {
+        TextureLayer layer = TextureArrays::Find(texture.path);
+        if (!layer.Valid()) { layers.clear(); break; }
+        layers.push_back(layer);
+    }
+    // 每种类型取第一个纹理的层编码成顶点属性（没有打包时全为-1）
+    packedLayers = ivec4(-1);
+    for (size_t i = 0; i < layers.size(); i++) {
+        for (int t = 0; t < 4; t++) {
+            if (this->textures[i].type == AssetCache::textureTypes[t].second && packedLayers[t] < 0) {
+                packedLayers[t] = layers[i].Packed();
+                break;
+            }
+        }
+    }
     SetUpMesh(); // 初始化OpenGL对象
+    MeshletCulling::Build(vao, this->vertices, this->indices); // 切分网格簇（小网格不切）
 }
 
 // 默认构造函数（留空）
 Mesh::Mesh() {}
 
-// 析构函数（无资源释放，OpenGL对象在外部管理）
+// 析构函数（Mesh按值拷贝进Model::meshes，拷贝共用同一组OpenGL对象，由所属Model析构时调用Release释放）
 Mesh::~Mesh() {}
 
+// 释放OpenGL对象和网格簇（纹理由Model按加载记录归还）
+void Mesh::Release() {
+    MeshletCulling::Remove(vao);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+    vao = vbo = ebo = 0;
+}
+
+// 顶点和索引缓冲占用的显存
+size_t Mesh::GpuBytes() const {
+    return vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+}
+
 // 初始化OpenGL对象（VAO/VBO/EBO，设置顶点属性指针）
 void Mesh::SetUpMesh() {
     glGenVertexArrays(1, &vao); // 生成顶点数组对象
@@ -600,17 +7365,38 @@ void Mesh::SetUpMesh() {
 void Model::LoadModel(string path) {
     std::cout << path << std::endl;
     Assimp::Importer importer;
-    // 读取模型文件，应用后处理（翻转UV、三角化、计算切线空间）
-    const aiScene* scene = importer.ReadFile(path, aiProcess_FlipUVs | aiProcess_Triangulate | aiProcess_CalcTangentSpace);
+    ImportedModel imported;
+    const aiScene* scene;
+    if (AssetCache::TakeImport(path, imported)) { // WorldStreamer已在后台线程导入并解码了纹理，这里只转换数据和上传
+        scene = imported.importer->GetScene();
+        for (auto& image : imported.images) Vfs::Stage(image.first, image.second);
+        imported.images.clear();
+    } else {
+        importer.SetIOHandler(new VfsIOSystem()); // 模型及其引用的材质库都从Vfs读取（导入器负责释放）
+        // 读取模型文件，应用后处理（翻转UV、三角化、计算切线空间）
+        scene = importer.ReadFile(path, AssetCache::importFlags);
+    }
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         std::cout << "Assimp error" << std::endl;
         return; // 加载失败
     }
 
-    Directory = path.substr(0, path.find_last_of('\\')); // 获取模型文件目录
-    name += path.substr(path.find_last_of('\\') + 1, path.length()); // 设置模型名称
+    Directory = path.substr(0, path.find_last_of("\\/")); // 获取模型文件目录
+    name += path.substr(path.find_last_of("\\/") + 1, path.length()); // 设置模型名称
+    boundsMin = vec3(FLT_MAX);  // 包围盒在处理网格时扩展
+    boundsMax = vec3(-FLT_MAX);
+    meshes.reserve(scene->mNumMeshes);
+    Animation::ImportSkeleton(this, scene); // 骨架和动画片段（处理网格时按名字查找骨骼）
     ProcessNode(scene->mRootNode, scene); // 递归处理模型节点
+    if (Animation::IsSkinnedModel(this)) { // 绑定姿势的包围盒放大一半，容纳动画中伸出的肢体
+        vec3 center = (boundsMin + boundsMax) * 0.5f, extent = (boundsMax - boundsMin) * 0.75f;
+        boundsMin = center - extent;
+        boundsMax = center + extent;
+    }
+    if (TextureArrays::enable) TextureArrays::Build(); // 上传本次导入打包的纹理层
+    Vfs::ClearStaged();                // 已加载过的纹理没有用到暂存的像素
+    AssetCache::FreeImport(imported);
 }
 
 // 处理模型节点（递归遍历子节点和网格）
@@ -631,6 +7417,9 @@ Mesh Model::processAiMesh(aiMesh * aiMesh, const aiScene * aiscene) {
     std::vector<Vertex> temVertexes;
     std::vector<unsigned int> tempIndices;
     std::vector<Texture> tempTextures;
+    // 预先分配好容量，避免push_back过程中反复扩容
+    temVertexes.reserve(aiMesh->mNumVertices);
+    tempIndices.reserve(aiMesh->mNumFaces * 3);
 
     Vertex tempVer;
     // 提取顶点数据（位置、法线、纹理坐标、切线）
@@ -643,6 +7432,9 @@ Mesh Model::processAiMesh(aiMesh * aiMesh, const aiScene * aiscene) {
             tempVer.tangent = vec3(aiMesh->mTangents[i].x, aiMesh->mTangents[i].y, aiMesh->mTangents[i].z);
             tempVer.bitangent = vec3(aiMesh->mBitangents[i].x, aiMesh->mBitangents[i].y, aiMesh->mBitangents[i].z);
         }
+        // 扩展模型空间包围盒（用于遮挡测试和遮挡体代理网格）
+        boundsMin = min(boundsMin, tempVer.position);
+        boundsMax = max(boundsMax, tempVer.position);
         temVertexes.push_back(tempVer);
     }
 
@@ -655,23 +7447,40 @@ Mesh Model::processAiMesh(aiMesh * aiMesh, const aiScene * aiscene) {
 
     // 加载材质纹理（漫反射、高光、法线、高度）
     aiMaterial* material = aiscene->mMaterials[aiMesh->mMaterialIndex];
-    tempTextures.insert(tempTextures.end(), loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse").begin(), loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse").end());
-    tempTextures.insert(tempTextures.end(), loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular").begin(), loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular").end());
-    tempTextures.insert(tempTextures.end(), loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal").begin(), loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal").end());
-    tempTextures.insert(tempTextures.end(), loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height").begin(), loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height").end());
+    for (auto& type : AssetCache::textureTypes) { // 每种类型只加载一次，结果直接追加
+        std::vector<Texture> loaded = loadMaterialTextures(material, type.first, type.second);
+        tempTextures.insert(tempTextures.end(), loaded.begin(), loaded.end());
+    }
 
-    return Mesh(temVertexes, tempIndices, tempTextures); // 创建并返回Mesh对象
+    Mesh mesh(std::move(temVertexes), std::move(tempIndices), std::move(tempTextures)); // 创建Mesh对象（移动，不复制顶点）
+    // 有骨骼的网格挂上蒙皮顶点缓冲；形状随动画变化，绑定姿势的簇包围数据不再有效
+    if (Animation::ImportSkin(this, aiMesh, mesh.vao)) MeshletCulling::Remove(mesh.vao);
+    return mesh;
 }
 
 // 加载材质纹理（避免重复加载）
 std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName) {
     std::vector<Texture> textures;
+    // 单独加载的纹理（优先使用压缩纹理）；也用于纹理数组装不下的纹理
+    auto loadSeparate = [&](const string& file) {
+        string ktx = TextureStreamer::Resolve(file, this->Directory);
+        return ktx.empty() ? Vfs::LoadTexture(file, this->Directory) : TextureStreamer::Load(ktx);
+    };
+    // 打包到纹理数组的纹理以数组的键为路径（Mesh和析构时按它查找），id为0；打包失败时单独加载，路径为原始路径
+    auto load = [&](const string& file, Texture& texture) {
+        if (TextureArrays::enable && TextureArrays::Add(file, this->Directory).Valid()) {
+            texture.id = 0;
+            texture.path = TextureArrays::Key(file, this->Directory);
+        } else {
+            texture.id = loadSeparate(file);
+            texture.path = file;
+        }
+    };
     if (mat->GetTextureCount(type) == 0) {
         // 如果没有纹理，使用默认纹理（示例逻辑，实际项目中可能需要处理错误）
         Texture texture;
-        texture.id = TextureFromFile((typeName + ".jpg").c_str(), this->Directory);
+        load(typeName + ".jpg", texture); // 数组在模型加载结束时统一上传
         texture.type = typeName;
-        texture.path = typeName.c_str();
         textures.push_back(texture);
         textures_loaded.push_back(texture);
     } else {
@@ -679,10 +7488,12 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
             aiString str;
             mat->GetTexture(type, i, &str);
+            string file = str.C_Str();
+            string key = TextureArrays::enable ? TextureArrays::Key(file, this->Directory) : file;
             bool skip = false;
-            // 检查纹理是否已加载
+            // 检查纹理是否已加载（已打包的按数组的键，单独加载的按原始路径）
             for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
+                if (textures_loaded[j].path == key || textures_loaded[j].path == file) {
                     textures.push_back(textures_loaded[j]);
                     skip = true;
                     break;
@@ -691,9 +7502,8 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType
             if (!skip) {
                 // 加载新纹理
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->Directory);
+                load(file, texture);
                 texture.type = typeName;
-                texture.path = str.C_Str();
                 textures.push_back(texture);
                 textures_loaded.push_back(texture);
             }
@@ -718,13 +7528,36 @@ void Model::Draw(Shader * shader) {
     }
 }
 
+// 只绘制几何体（阴影、深度预渲染等不需要纹理的通道）
+void Model::DrawDepth() const {
+    for (const Mesh& mesh : meshes) {
+        glBindVertexArray(mesh.vao);
+        MeshletCulling::Draw(mesh.vao, (GLsizei)mesh.indices.size());
+    }
+    glBindVertexArray(0);
+}
+
 // 构造函数（加载模型文件）
 Model::Model(string path) : Object("Model_") {
     LoadModel(path); // 调用加载模型方法
 }
 
-// 析构函数（无资源释放，Mesh资源在Mesh类中管理）
-Model::~Model() {}
+// 模型的网格显存（纹理按路径共享，单独统计）
+size_t Model::GpuBytes() const {
+    size_t bytes = 0;
+    for (const Mesh& mesh : meshes) bytes += mesh.GpuBytes();
+    return bytes;
+}
+
+// 析构函数（释放网格的OpenGL对象、蒙皮缓冲，归还加载时取得的纹理引用）
+Model::~Model() {
+    for (Mesh& mesh : meshes) mesh.Release();
+    Animation::Remove(this);
+    for (const Texture& texture : textures_loaded) {
+        if (texture.id == 0) TextureArrays::Release(texture.path); // 打包在纹理数组中
+        else if (!TextureStreamer::Release(texture.id)) Vfs::ReleaseTexture(texture.id);
+    }
+}
 
 #pragma endregion
 
@@ -750,27 +7583,15 @@ void Shader::OnGUI() const {
 Shader::Shader(string sign, const char* geometryPath) : Object("Shader_" + sign) {
     std::cout << "Shader Name: " << sign << std::endl;
     std::string vertexCode, fragmentCode, geometryCode;
-    // 读取着色器文件
-    try {
-        std::ifstream vShaderFile(sign + ".vert"), fShaderFile(sign + ".frag");
-        std::stringstream vShaderStream, fShaderStream;
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        vShaderFile.close();
-        fShaderFile.close();
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-        // 加载几何着色器（如果提供路径）
-        if (geometryPath != nullptr) {
-            std::ifstream gShaderFile(geometryPath);
-            std::stringstream gShaderStream;
-            gShaderStream << gShaderFile.rdbuf();
-            gShaderFile.close();
-            geometryCode = gShaderStream.str();
-        }
-    } catch (std::ifstream::failure e) {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-    }
+    // 读取着色器文件（通过Vfs，打包后不再逐个打开文件）
+    VfsFile vShaderFile, fShaderFile, gShaderFile;
+    bool read = Vfs::Read(sign + ".vert", vShaderFile) && Vfs::Read(sign + ".frag", fShaderFile);
+    // 加载几何着色器（如果提供路径）
+    if (geometryPath != nullptr) read = Vfs::Read(geometryPath, gShaderFile) && read;
+    if (!read) std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+    vertexCode = vShaderFile.Text();
+    fragmentCode = fShaderFile.Text();
+    geometryCode = gShaderFile.Text();
 
     // 编译顶点和片段着色器
     unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -799,6 +7620,12 @@ Shader::Shader(string sign, const char* geometryPath) : Object("Shader_" + sign)
     if (geometryPath != nullptr) glAttachShader(ID, geometry);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM"); // 检查链接错误
+    // 声明了FrameData/DrawData块的着色器走环形缓冲，否则仍逐个设置Uniform
+    uniformBlocks = glGetUniformBlockIndex(ID, "DrawData") != GL_INVALID_INDEX;
+    UniformRing::BindBlocks(ID);
+    use();
+    setInt("shadowAtlas", ShadowSystem::atlasUnit); // 阴影图集常驻固定纹理单元
+    TextureArrays::BindSamplers(ID);                // 纹理数组同样常驻固定单元
 
     // 清理临时着色器对象
     glDeleteShader(vertex);
@@ -811,6 +7638,11 @@ void Shader::use() {
     glUseProgram(ID); // 设置当前使用的着色器程序
 }
 
+// 析构函数（删除着色器程序）
+Shader::~Shader() {
+    glDeleteProgram(ID);
+}
+
 // 设置Uniform布尔值
 void Shader::setBool(const std::string &name, bool value) const {
     glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); // 获取位置并设置值
@@ -853,7 +7685,7 @@ void AbstractMaterial::OnGUI() const {
         ImGui::Text("name: %s", name.c_str()); // 显示材质名称
         ImGui::Checkbox("EnableSpecular", (bool*)&specular); // 高光反射启用状态
         ImGui::DragFloat("Skininess", (float*)&shininess, 0.5f, 1, 64); // 光泽度拖动条
-        ImGui::ColorEdit3((name + "_color").c_str(), (float*)&color); // 颜色选择器
+        ImGui::ColorEdit3("Color", (float*)&color); // 颜色选择器
         shader->OnGUI(); // 显示关联的着色器信息
         ImGui::TreePop(); // 结束树节点
         ImGui::Spacing(); // 增加间距
@@ -866,6 +7698,12 @@ AbstractMaterial::~AbstractMaterial() {}
 // 应用材质（设置通用Uniform变量）
 void AbstractMaterial::Use(mat4 & view, mat4 & proj, mat4 model) {
     shader->use(); // 激活着色器
+    if (shader->uniformBlocks) {
+        // 视图、投影、相机位置已在每帧数据中，这里只写入逐绘制数据并绑定偏移（已由RenderPipeline写入时只绑定）
+        if (UniformRing::sharedDraw >= 0) UniformRing::BindDraw(UniformRing::sharedDraw);
+        else UniformRing::PushDraw(MaterialDrawUniforms(this, model));
+        return;
+    }
     // 设置变换矩阵
     shader->setMat4("viewMat", view);
     shader->setMat4("projMat", proj);
@@ -874,6 +7712,7 @@ void AbstractMaterial::Use(mat4 & view, mat4 & proj, mat4 model) {
     shader->setFloat("material.shininess", shininess);
     shader->setVec3("material.color", color);
     shader->setBool("specular", specular);
+    shader->setInt("skinned", UniformRing::drawSkinned);
     // 设置相机位置
     shader->setVec3("cameraPos", Setting::MainCamera->gameObject->transform()->position);
 }
@@ -896,6 +7735,7 @@ StandandMaterial::~StandandMaterial() {}
 // 应用材质（添加光照参数）
 void StandandMaterial::Use(mat4 & view, mat4 & proj, mat4 model) {
     AbstractMaterial::Use(view, proj, model); // 调用基类实现
+    if (shader->uniformBlocks) return; // 光照已在每帧数据中
     for (auto light : *Setting::lights) // 遍历所有光照并添加到着色器
         shader->AddLight(light);
 }
@@ -919,8 +7759,9 @@ void BoxMaterial::OnGUI() const {
 void BoxMaterial::Use(mat4 & view, mat4 & proj, mat4 model) {
     AbstractMaterial::Use(view, proj, model); // 调用基类实现
     // 设置纹理单元（假设纹理0为漫反射，纹理1为高光）
-    shader->setInt("material.texture_diffuse0", TextureFromFile(diffusePath));
-    shader->setInt("material.texture_specular0", TextureFromFile(specularPath));
+    shader->setInt("material.texture_diffuse0", Vfs::SharedTexture(diffusePath, "")); // 按路径缓存，不再每帧重新加载
+    shader->setInt("material.texture_specular0", Vfs::SharedTexture(specularPath, ""));
+    if (shader->uniformBlocks) return; // 光照已在每帧数据中
     for (auto light : *Setting::lights) // 添加光照参数
         shader->AddLight(light);
 }
@@ -941,19 +7782,28 @@ void ModelRender::OnGUI() const {
     model->OnGUI(); // 显示模型信息
 }
 
-// 物理更新（渲染模型）
+// 物理更新（提交到渲染通道，由RenderPipeline按通道顺序绘制）
 void ModelRender::RealUpdate() {
     MonoBehavior::RealUpdate();
-    // 应用材质并绘制模型
-    material->Use(viewMat, projMat, gameObject->transform()->GetModelMaterix());
+    // 每帧只计算一次模型矩阵；视锥和遮挡剔除由RenderPipeline按视图进行
+    RenderPipeline::Submit(this, gameObject->transform()->GetModelMaterix());
+}
+
+// 绘制（着色通道中调用）
+void ModelRender::Draw(const mat4 & modelMat) {
+    // 应用材质并绘制模型（只计算空间索引分配给该物体的光源）
+    UniformRing::drawLightMask = SpatialIndex::LightMask(gameObject);
+    UniformRing::drawSkinned = Animation::Bind(gameObject); // 蒙皮角色绑定自己的骨骼矩阵区间
+    material->Use(viewMat, projMat, modelMat);
     model->Draw(material->shader);
+    UniformRing::drawSkinned = 0;
 }
 
-// 初始化（创建材质和模型）
+// 初始化（创建材质，模型和着色器从共享缓存获取，同一文件只加载一次）
 void ModelRender::Start() {
     MonoBehavior::Start();
-    material = new StandandMaterial(new Shader(shaderName)); // 创建标准材质
-    model = new Model(workDir.substr(0, workDir.find_last_of('\\')) + "\\" + modelName); // 加载模型
+    material = new StandandMaterial(AssetCache::AcquireShader(shaderName)); // 创建标准材质
+    model = AssetCache::AcquireModel(workDir.substr(0, workDir.find_last_of('\\')) + "\\" + modelName); // 加载模型
 }
 
 // 构造函数（设置组件名称）
@@ -961,10 +7811,12 @@ ModelRender::ModelRender() {
     name += "ModelRender"; // 设置组件名称
 }
 
-// 析构函数（释放材质和模型资源）
+// 析构函数（释放材质，归还共享的模型和着色器）
 ModelRender::~ModelRender() {
+    RenderPipeline::Withdraw(this); // 还没绘制的提交引用着本组件
+    AssetCache::Release(material->shader);
+    AssetCache::Release(model);
     delete material;
-    delete model;
 }
 
 #pragma endregion
@@ -1002,28 +7854,34 @@ void SkyboxRender::OnGUI() const {
     MonoBehavior::OnGUI(); // 显示基类的启用状态复选框
 }
 
-// 物理更新（渲染天空盒）
+// 物理更新（提交天空盒，由RenderPipeline在不透明物体之后绘制）
 void SkyboxRender::RealUpdate() {
     MonoBehavior::RealUpdate();
+    RenderPipeline::SubmitSky(this);
+}
+
+// 绘制天空盒（深度状态由RenderPipeline设置）
+void SkyboxRender::Draw() {
     material->Use(viewMat, projMat, mat4(mat3(gameObject->transform()->GetModelMaterix()))); // 忽略模型矩阵的平移（天空盒始终在原点）
     material->shader->setInt("skybox", 0); // 设置天空盒纹理单元
-    glDepthMask(GL_FALSE); // 禁用深度写入（天空盒在最远平面）
     glBindVertexArray(vao); // 绑定天空盒VAO
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureId); // 绑定立方体贴图
     glDrawArrays(GL_TRIANGLES, 0, 36); // 绘制天空盒
     glBindVertexArray(0); // 解绑
-    glDepthMask(GL_TRUE); // 恢复深度写入
 }
 
 // 构造函数（加载天空盒纹理）
 SkyboxRender::SkyboxRender() {
     name += "SkyboxRender"; // 设置组件名称
-    textureId = loadCubemap(faces); // 加载立方体贴图
+    // 加载立方体贴图（有离线转换好的skybox.ktx2时流式加载压缩纹理）
+    textureId = Vfs::Exists("skybox.ktx2") ? TextureStreamer::Load("skybox.ktx2") : Vfs::LoadCubemap(faces);
 }
 
-// 析构函数（无资源释放，纹理ID由外部管理）
-SkyboxRender::~SkyboxRender() {}
+// 析构函数（撤回还没绘制的提交，纹理ID由外部管理）
+SkyboxRender::~SkyboxRender() {
+    RenderPipeline::Withdraw(this);
+}
 
 #pragma endregion
 
@@ -1050,13 +7908,24 @@ Transform * GameObject::transform() const {
 
 // ImGui 调试界面（显示启用状态和定位按钮）
 void GameObject::OnGUI() const {
-    ImGui::Checkbox("Enable", (bool*)&enable); // 启用状态复选框
+    if (ImGui::Checkbox("Enable", (bool*)&enable)) { // 启用状态复选框
+        if (auto caster = GetComponent<ShadowCaster>()) ShadowSystem::Invalidate(caster); // 阴影缓存按事件更新
+    }
     if (ImGui::Button("Go to here")) { // 定位按钮
         if (Setting::MainCamera && Setting::MainCamera->gameObject->enable)
             Setting::MainCamera->gameObject->transform()->position = transform()->position; // 移动主相机到当前对象位置
     }
 }
 
+// 游戏对象从内存池分配
+void* GameObject::operator new(size_t size) {
+    return PoolAllocator::Allocate(size, AllocTag::GameObjects);
+}
+
+void GameObject::operator delete(void * p, size_t size) {
+    PoolAllocator::Free(p, size, AllocTag::GameObjects);
+}
+
 // 静态ID生成器（确保每个对象ID唯一）
 static int idS = 0;
 
@@ -1064,7 +7933,9 @@ static int idS = 0;
 GameObject::GameObject(string name, Type type) : Object("GameObject_" + name) {
     this->id = idS++; // 分配唯一ID
     Setting::gameObjects->push_back(this); // 添加到全局游戏对象列表
-    scripts = new std::list<MonoBehavior*>(); // 初始化脚本列表
+    SceneInspector::Add(this); // 加入检视面板的名称索引
+    SpatialIndex::Add(this); // 加入空间索引（首次同步时插入树）
+    scripts = new ScriptList(); // 初始化脚本列表（链表节点来自内存池）
     AddComponentStart<Transform>(); // 添加Transform组件
 
     switch (type) {
@@ -1085,6 +7956,8 @@ GameObject::GameObject(string name, Type type) : Object("GameObject_" + name) {
 
 // 析构函数（释放所有脚本组件资源）
 GameObject::~GameObject() {
+    SceneInspector::Remove(this); // 移出检视面板的名称索引
+    SpatialIndex::Remove(this); // 移出空间索引
     for (auto x : *scripts)
         delete x; // 释放每个脚本组件
     delete scripts; // 释放脚本列表
@@ -1118,7 +7991,10 @@ int Setting::LightCount(AbstractLight::LightType type) {
 void Setting::InitSettings() {
     pWindowSize = &windowSize; // 设置窗口尺寸指针
     lights = new std::vector<AbstractLight*>(); // 创建光照列表
+    lights->reserve(MAX_UNIFORM_LIGHTS); // 预留容量，添加光源时不再扩容
     gameObjects = new std::list<GameObject*>(); // 创建游戏对象列表
+    string assetRoot = workDir.substr(0, workDir.find_last_of('\\')); // 与模型路径相同的资源根目录
+    Vfs::Mount(assetRoot + "\\assets.pak", assetRoot, workDir); // 没有档案时读取散文件
 }
 
 #pragma endregion